@@ -0,0 +1,135 @@
+/*
+ * File: affinity.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library allows the placement of the workers and of their memory:
+ * pinning a worker to a processor, touching its part of the buffers first
+ * (so that the kernel allocates its pages on the NUMA node of the worker)
+ * and reporting on which node the pages of a buffer are.
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "headers/affinity.h"
+
+/* Number of pages asked to the kernel at once */
+#define AFFINITY_BATCH 1024
+
+int affinity_cpu(int id) {
+    assert(id >= 0);
+
+    cpu_set_t set;
+    int cpu, count, n;
+
+    if(sched_getaffinity(0, sizeof(set), &set) == -1 || (count = CPU_COUNT(&set)) == 0)
+        return -1;
+
+    // The (id mod count)-th allowed processor
+    n = id % count;
+
+    for(cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if(CPU_ISSET(cpu, &set) && n-- == 0)
+            return cpu;
+
+    return -1;
+}
+
+void affinity_pin(int cpu) {
+    cpu_set_t set;
+
+    if(cpu < 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    // Only the calling thread (0) is pinned, not the whole process
+    if(sched_setaffinity(0, sizeof(set), &set) == -1)
+        perror("sched_setaffinity");
+}
+
+int affinity_save(affinity_mask* mask) {
+    assert(mask != NULL);
+
+    return sched_getaffinity(0, sizeof(mask->words), (cpu_set_t*)mask->words) == -1 ? -1 : 0;
+}
+
+void affinity_restore(const affinity_mask* mask) {
+    assert(mask != NULL);
+
+    if(sched_setaffinity(0, sizeof(mask->words), (const cpu_set_t*)mask->words) == -1)
+        perror("sched_setaffinity");
+}
+
+int affinity_node(void) {
+    unsigned cpu, node;
+
+    if(syscall(SYS_getcpu, &cpu, &node, NULL) == -1)
+        return -1;
+
+    return node;
+}
+
+void affinity_touch(long* buffer, size_t begin, size_t end) {
+    size_t i, step;
+
+    if(buffer == NULL)
+        return;
+
+    step = sysconf(_SC_PAGESIZE) / sizeof(long);
+
+    for(i = begin; i < end; i += step)
+        buffer[i] = 0;
+
+    // The last page of the part may start before *i*
+    if(end > begin)
+        buffer[end - 1] = 0;
+}
+
+long affinity_pages(long* buffer, size_t size, long* pages) {
+    assert(pages != NULL);
+
+    void* batch[AFFINITY_BATCH];
+    int status[AFFINITY_BATCH];
+    size_t page, count, first, i;
+    long unknown;
+
+    for(i = 0; i < AFFINITY_NODES; i++)
+        pages[i] = 0;
+
+    if(buffer == NULL || size == 0)
+        return 0;
+
+    page = sysconf(_SC_PAGESIZE);
+    count = (size + page - 1) / page;
+    unknown = 0;
+
+    for(first = 0; first < count; first += AFFINITY_BATCH) {
+        // Pages of a shared mapping touched by another process must be mapped here too
+        for(i = 0; i < AFFINITY_BATCH && first + i < count; i++) {
+            batch[i] = (char*)buffer + (first + i) * page;
+
+            (void)*(volatile char*)batch[i];
+        }
+
+        // Without target nodes, move_pages only tells where the pages are
+        if(syscall(SYS_move_pages, 0, i, batch, NULL, status, 0) == -1) {
+            unknown += i;
+
+            continue;
+        }
+
+        while(i-- > 0) {
+            if(status[i] >= 0 && status[i] < AFFINITY_NODES)
+                pages[status[i]]++;
+            else
+                unknown++;
+        }
+    }
+
+    return unknown;
+}
@@ -0,0 +1,665 @@
+/*
+ * File: bench.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * The benchmark of the sort: it generates arrays of several sizes and
+ * distributions, sorts them with qsort and with the radix sort for each
+ * number of workers, and writes one CSV line per measure (the time is the
+ * best of several repetitions, the speedup is relative to one worker).
+ * The in-place sort and the write-combining scatter can be measured too,
+ * against the sort that uses a scratch buffer.
+ *
+ * Each measure is done in its own process, so that its peak memory (the
+ * resident set of the process and of its workers) is its own.
+ *
+ * Compilation
+ * -----------
+ * gcc -O2 bench.c affinity.c array.c communication.c deque.c histogram.c
+ *     pass.c pool.c radix.c trace.c --pedantic -Wall -Wextra
+ *     -Wmissing-prototypes -pthread -lm -o bench
+ *
+ * Usage
+ * -----
+ * ./bench [options]
+ * example: ./bench -n 1K,1M,100M -j 1,2,4,8 -b 8,11,16 > results.csv
+ *
+ * Option(s)
+ * ---------
+ * -n, --sizes: the sizes of the arrays (K, M and B stand for thousands,
+ *              millions and billions, default: 1K,1M,16M)
+ * -d, --distributions: the distributions of the keys among uniform, zipf,
+ *                      few-unique, sorted, reversed and clustered
+ *                      (default: all of them)
+ * -j, --workers: the numbers of workers (default: 1, 2, 4, ... up to the
+ *                number of online processors)
+ * -b, --bits: the bits of a digit (default: 8)
+ * -r, --repeat: the number of repetitions of a measure (default: 3)
+ * -s, --seed: the seed of the generator (default: 1)
+ * -t, --threads: the workers are threads of a single process
+ * -M, --msd: sort from the most significant digit
+ * -I, --in-place: also measure the in-place sort (American flag), whose
+ *                 cost is its time over the one of the sort above
+ * -W, --write-combining: also measure the sort whose scatter goes through
+ *                        write-combining lines, whose cost is its time
+ *                        over the one of the sort above
+ * -Q, --no-qsort: do not measure qsort
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "headers/radix.h"
+
+/* Maximal number of values of a list option */
+#define BENCH_LIST 32
+
+/* Distinct keys of the few-unique distribution, and centres and spread of the clustered one */
+#define FEW_UNIQUE 16
+#define CLUSTERS 64
+#define CLUSTER_SPREAD (1L << 16)
+
+/* Ranks of the Zipf distribution (of exponent ZIPF_S) */
+#define ZIPF_RANKS (1 << 20)
+#define ZIPF_S 1.0
+
+/* ----- Distributions ----- */
+typedef enum {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_FEW_UNIQUE,
+    DIST_SORTED,
+    DIST_REVERSED,
+    DIST_CLUSTERED,
+    DIST_COUNT
+} distribution;
+
+static const char* dist_names[] = {"uniform", "zipf", "few-unique", "sorted", "reversed", "clustered"};
+
+/* ----- Variants of the radix sort ----- */
+typedef enum {
+    SORT_SCRATCH,
+    SORT_IN_PLACE,
+    SORT_COMBINED,
+    SORT_COUNT
+} variant;
+
+static const char* sort_names[] = {"radix", "radix-in-place", "radix-combined"};
+
+/* Result of a measure (written by its process) */
+typedef struct {
+    double seconds;
+    int passes;
+} measure;
+
+/* ----- Prototypes ----- */
+static unsigned long next_random(unsigned long* state);
+static void generate(long* keys, size_t n, distribution dist, unsigned long seed);
+static int parse_list(const char* str, long* list, bool suffix);
+static int parse_distributions(const char* str, long* list);
+static double now(void);
+static int compare(const void* a, const void* b);
+static bool sorted(const long* keys, size_t n);
+static measure run(const long* keys, size_t n, int workers, const radix_opts* opts, int repeat);
+static bool measure_in_child(const long* keys, size_t n, int workers, const radix_opts* opts, int repeat, measure* result, long* peak);
+
+/* ----- Generator (xorshift64*) ----- */
+static unsigned long next_random(unsigned long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717UL;
+}
+
+/* ----- Keys of a distribution ----- */
+static void generate(long* keys, size_t n, distribution dist, unsigned long seed) {
+    /* ----- Variable declaration ----- */
+    unsigned long state, centres[CLUSTERS], unique[FEW_UNIQUE];
+    double* cdf;
+    double u, sum;
+    size_t i, lo, hi, mid, ranks;
+
+    state = seed * 0x9E3779B97F4A7C15UL + 1;
+
+    switch(dist) {
+        case DIST_UNIFORM:
+            for(i = 0; i < n; i++)
+                keys[i] = next_random(&state);
+
+            break;
+
+        case DIST_ZIPF:
+            // Inverse of the cumulative distribution of the ranks, the ranks
+            // being spread over the keys by a multiplication
+            ranks = n < ZIPF_RANKS ? n : ZIPF_RANKS;
+
+            if((cdf = malloc(ranks * sizeof(double))) == NULL) {
+                perror("Error with malloc");
+
+                exit(errno);
+            }
+
+            for(sum = 0, i = 0; i < ranks; i++)
+                cdf[i] = (sum += 1.0 / pow(i + 1, ZIPF_S));
+
+            for(i = 0; i < n; i++) {
+                u = (next_random(&state) >> 11) * (sum / (1UL << 53));
+
+                for(lo = 0, hi = ranks - 1; lo < hi;) {
+                    mid = (lo + hi) / 2;
+
+                    if(cdf[mid] < u)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+
+                keys[i] = (long)((lo + 1) * 0xD6E8FEB86659FD93UL);
+            }
+
+            free(cdf);
+
+            break;
+
+        case DIST_FEW_UNIQUE:
+            for(i = 0; i < FEW_UNIQUE; i++)
+                unique[i] = next_random(&state);
+
+            for(i = 0; i < n; i++)
+                keys[i] = unique[next_random(&state) % FEW_UNIQUE];
+
+            break;
+
+        case DIST_SORTED:
+        case DIST_REVERSED:
+            for(i = 0; i < n; i++)
+                keys[i] = LONG_MIN / 2 + (long)(dist == DIST_SORTED ? i : n - 1 - i) * 1021;
+
+            break;
+
+        case DIST_CLUSTERED:
+            for(i = 0; i < CLUSTERS; i++)
+                centres[i] = next_random(&state);
+
+            for(i = 0; i < n; i++)
+                keys[i] = centres[next_random(&state) % CLUSTERS] + next_random(&state) % CLUSTER_SPREAD;
+
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ----- Parsing of a comma separated list of numbers (with an optional K, M or B suffix) ----- */
+static int parse_list(const char* str, long* list, bool suffix) {
+    char* endp;
+    long value;
+    int count;
+
+    for(count = 0; *str != '\0'; count++) {
+        errno = 0;
+        value = strtol(str, &endp, 10);
+
+        if(errno != 0 || endp == str || value <= 0 || count == BENCH_LIST)
+            return -1;
+
+        if(suffix) {
+            switch(*endp) {
+                case 'B': case 'b': case 'G': case 'g':
+                    value *= 1000;
+                    /* fall through */
+                case 'M': case 'm':
+                    value *= 1000;
+                    /* fall through */
+                case 'K': case 'k':
+                    value *= 1000;
+                    endp++;
+                    break;
+            }
+        }
+
+        if(*endp != ',' && *endp != '\0')
+            return -1;
+
+        list[count] = value;
+        str = *endp == ',' ? endp + 1 : endp;
+    }
+
+    return count;
+}
+
+/* ----- Parsing of a comma separated list of distributions ----- */
+static int parse_distributions(const char* str, long* list) {
+    size_t length;
+    int count, d;
+
+    for(count = 0; *str != '\0'; count++) {
+        length = strcspn(str, ",");
+
+        for(d = 0; d < DIST_COUNT; d++)
+            if(strlen(dist_names[d]) == length && strncmp(str, dist_names[d], length) == 0)
+                break;
+
+        if(d == DIST_COUNT || count == BENCH_LIST)
+            return -1;
+
+        list[count] = d;
+        str += str[length] == ',' ? length + 1 : length;
+    }
+
+    return count;
+}
+
+/* ----- Time (in seconds) ----- */
+static double now(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* ----- Comparison of qsort ----- */
+static int compare(const void* a, const void* b) {
+    long x = *(const long*)a;
+    long y = *(const long*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* ----- Order of an array ----- */
+static bool sorted(const long* keys, size_t n) {
+    size_t i;
+
+    for(i = 1; i < n; i++)
+        if(keys[i - 1] > keys[i])
+            return false;
+
+    return true;
+}
+
+/* ----- Best time of a sort (qsort if *workers* is 0) ----- */
+static measure run(const long* keys, size_t n, int workers, const radix_opts* opts, int repeat) {
+    /* ----- Variable declaration ----- */
+    radix_opts custom;
+    radix_ctx* ctx;
+    measure result;
+    long* array;
+    double start, seconds;
+    int r;
+
+    ctx = NULL;
+    array = NULL;
+
+    if(workers == 0 && (array = malloc(n * sizeof(long))) == NULL) {
+        perror("Error with malloc");
+
+        exit(errno);
+    }
+
+    if(workers > 0) {
+        custom = *opts;
+        custom.workers = workers;
+
+        if((ctx = radix_create(n, &custom)) == NULL) {
+            printf("The context of the sort could not be allocated.\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    result.seconds = -1;
+    result.passes = 0;
+
+    /* ----- Repetitions (the context is kept, as by a caller sorting several arrays) ----- */
+    for(r = 0; r < repeat; r++) {
+        // The radix sort works in place in its own buffer (shared with its workers)
+        if(ctx != NULL && (array = radix_buffer(ctx)) == NULL) {
+            printf("The buffer of the sort could not be allocated.\n");
+
+            exit(EXIT_FAILURE);
+        }
+
+        memcpy(array, keys, n * sizeof(long));
+
+        start = now();
+
+        if(ctx != NULL)
+            radix_run(ctx, array, array, n);
+        else
+            qsort(array, n, sizeof(long), compare);
+
+        seconds = now() - start;
+
+        if(!sorted(array, n)) {
+            printf("The array has not been sorted.\n");
+
+            exit(EXIT_FAILURE);
+        }
+
+        if(result.seconds < 0 || seconds < result.seconds)
+            result.seconds = seconds;
+    }
+
+    if(ctx != NULL) {
+        result.passes = ctx->executed;
+
+        radix_destroy(ctx);
+    } else {
+        free(array);
+    }
+
+    return result;
+}
+
+/* ----- Measure in a process of its own, which reports its result through a pipe ----- */
+static bool measure_in_child(const long* keys, size_t n, int workers, const radix_opts* opts, int repeat, measure* result, long* peak) {
+    /* ----- Variable declaration ----- */
+    struct rusage usage;
+    int fd[2], status;
+    pid_t pid;
+    ssize_t got;
+
+    // The buffered lines must not be written again by the child
+    fflush(stdout);
+
+    if(pipe(fd) == -1) {
+        perror("Error with pipe");
+
+        exit(errno);
+    }
+
+    if((pid = fork()) == -1) {
+        perror("Error with fork");
+
+        exit(errno);
+    }
+
+    if(pid == 0) {
+        close(fd[0]);
+
+        *result = run(keys, n, workers, opts, repeat);
+
+        if(write(fd[1], result, sizeof(measure)) != sizeof(measure))
+            exit(EXIT_FAILURE);
+
+        exit(EXIT_SUCCESS);
+    }
+
+    close(fd[1]);
+
+    got = read(fd[0], result, sizeof(measure));
+
+    close(fd[0]);
+
+    // The usage of a child includes the one of its own workers
+    if(wait4(pid, &status, 0, &usage) == -1) {
+        perror("Error with wait4");
+
+        exit(errno);
+    }
+
+    *peak = usage.ru_maxrss;
+
+    return got == sizeof(measure) && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/* ----- Main ----- */
+int main(int argc, char** argv) {
+    /* ----- Variable declaration ----- */
+    // Command line options
+    long sizes[BENCH_LIST], dists[BENCH_LIST], workers[BENCH_LIST], bits[BENCH_LIST];
+    int nsizes, ndists, nworkers, nbits, repeat, opt;
+    unsigned long seed;
+    bool threads, msd, american, combine, with_qsort;
+    char* endp;
+
+    static const struct option options[] = {
+        {"sizes", required_argument, NULL, 'n'},
+        {"distributions", required_argument, NULL, 'd'},
+        {"workers", required_argument, NULL, 'j'},
+        {"bits", required_argument, NULL, 'b'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"seed", required_argument, NULL, 's'},
+        {"threads", no_argument, NULL, 't'},
+        {"msd", no_argument, NULL, 'M'},
+        {"in-place", no_argument, NULL, 'I'},
+        {"write-combining", no_argument, NULL, 'W'},
+        {"no-qsort", no_argument, NULL, 'Q'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // Measures
+    radix_opts opts;
+    measure result, qsorted, single;
+    double scratch[BENCH_LIST];
+    long peak, single_peak;
+    long* keys;
+    int s, d, w, b, m;
+    long n, processors;
+
+    /* ----- Verification and get the user parameters ----- */
+    nsizes = parse_list("1K,1M,16M", sizes, true);
+    ndists = 0;
+    nworkers = 0;
+    nbits = parse_list("8", bits, false);
+    repeat = 3;
+    seed = 1;
+    threads = false;
+    msd = false;
+    american = false;
+    combine = false;
+    with_qsort = true;
+
+    while((opt = getopt_long(argc, argv, "n:d:j:b:r:s:tMIWQ", options, NULL)) != -1) {
+        switch(opt) {
+            case 'n':
+                if((nsizes = parse_list(optarg, sizes, true)) <= 0) {
+                    printf("The sizes should be a list such as 1K,1M,1B.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'd':
+                if((ndists = parse_distributions(optarg, dists)) <= 0) {
+                    printf("The distributions should be among uniform, zipf, few-unique, sorted, reversed and clustered.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'j':
+                if((nworkers = parse_list(optarg, workers, false)) <= 0) {
+                    printf("The numbers of workers should be a list such as 1,2,4.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'b':
+                if((nbits = parse_list(optarg, bits, false)) <= 0) {
+                    printf("The bits should be a list such as 8,11,16.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                for(b = 0; b < nbits; b++) {
+                    if(bits[b] > 24) {
+                        printf("The number of bits should be between 1 and 24.\n");
+
+                        return EXIT_FAILURE;
+                    }
+                }
+
+                break;
+
+            case 'r':
+                errno = 0;
+                repeat = strtol(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0 || repeat <= 0) {
+                    printf("The number of repetitions should be a strictly positive number.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 's':
+                errno = 0;
+                seed = strtoul(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0) {
+                    printf("The seed should be a positive number.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 't':
+                threads = true;
+
+                break;
+
+            case 'M':
+                msd = true;
+
+                break;
+
+            case 'I':
+                american = true;
+
+                break;
+
+            case 'W':
+                combine = true;
+
+                break;
+
+            case 'Q':
+                with_qsort = false;
+
+                break;
+
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+
+    // All the distributions, and powers of two up to the number of processors
+    if(ndists == 0)
+        for(ndists = 0; ndists < DIST_COUNT; ndists++)
+            dists[ndists] = ndists;
+
+    if(nworkers == 0) {
+        processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        for(w = 1; w < processors && nworkers < BENCH_LIST - 1; w *= 2)
+            workers[nworkers++] = w;
+
+        workers[nworkers++] = processors > 1 ? processors : 1;
+    }
+
+    radix_opts_init(&opts);
+
+    opts.threads = threads;
+    opts.msd = msd;
+
+    /* ----- Measures ----- */
+    printf("distribution,n,sorter,workers,bits,seconds,keys_per_sec,passes,peak_kb,speedup,qsort_speedup,in_place_cost,combined_cost\n");
+
+    for(s = 0; s < nsizes; s++) {
+        n = sizes[s];
+
+        if((keys = malloc(n * sizeof(long))) == NULL) {
+            perror("Error with malloc");
+
+            exit(errno);
+        }
+
+        for(d = 0; d < ndists; d++) {
+            generate(keys, n, dists[d], seed);
+
+            qsorted.seconds = 0;
+
+            if(with_qsort) {
+                if(!measure_in_child(keys, n, 0, &opts, repeat, &qsorted, &peak)) {
+                    printf("The measure of qsort failed.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                printf("%s,%ld,qsort,1,0,%.6f,%.0f,0,%ld,1.000,1.000,,\n", dist_names[dists[d]], n, qsorted.seconds, n / qsorted.seconds, peak);
+            }
+
+            for(b = 0; b < nbits; b++) {
+                opts.bits = bits[b];
+                opts.base = 1L << bits[b];
+
+                // With a scratch buffer, then the other variants (their cost is relative to the first one)
+                for(m = 0; m < SORT_COUNT; m++) {
+                    if((m == SORT_IN_PLACE && !american) || (m == SORT_COMBINED && !combine))
+                        continue;
+
+                    opts.american = m == SORT_IN_PLACE;
+                    opts.combine = m == SORT_COMBINED;
+
+                    // The baseline of the speedups: the radix sort by a single worker
+                    if(!measure_in_child(keys, n, 1, &opts, repeat, &single, &single_peak)) {
+                        printf("The measure of the radix sort failed.\n");
+
+                        return EXIT_FAILURE;
+                    }
+
+                    for(w = 0; w < nworkers; w++) {
+                        result = single;
+                        peak = single_peak;
+
+                        if(workers[w] != 1 && !measure_in_child(keys, n, workers[w], &opts, repeat, &result, &peak)) {
+                            printf("The measure of the radix sort failed.\n");
+
+                            return EXIT_FAILURE;
+                        }
+
+                        printf("%s,%ld,%s,%ld,%ld,%.6f,%.0f,%d,%ld,%.3f,", dist_names[dists[d]], n, sort_names[m], workers[w], bits[b], result.seconds, n / result.seconds, result.passes, peak, single.seconds / result.seconds);
+
+                        if(with_qsort)
+                            printf("%.3f", qsorted.seconds / result.seconds);
+
+                        if(m == SORT_SCRATCH) {
+                            scratch[w] = result.seconds;
+
+                            printf(",,\n");
+                        } else if(m == SORT_IN_PLACE) {
+                            printf(",%.3f,\n", result.seconds / scratch[w]);
+                        } else {
+                            printf(",,%.3f\n", result.seconds / scratch[w]);
+                        }
+                    }
+                }
+            }
+
+            fflush(stdout);
+        }
+
+        free(keys);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+/*
+ * File: client.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * A client of the sort daemon: it keeps several sorts of random arrays in
+ * flight in a region shared with the daemon, checks each sorted array and
+ * reports the number of sorts (and of keys) per second.
+ *
+ * Compilation
+ * -----------
+ * gcc client.c service.c --pedantic -Wall -Wextra -Wmissing-prototypes
+ *     -lrt -o client
+ *
+ * Usage
+ * -----
+ * ./client [options]
+ * example: ./client -n 10000 -q 64 -r 100000
+ *
+ * Option(s)
+ * ---------
+ * -n, --size: the number of keys of an array (default: 10000)
+ * -q, --in-flight: the number of sorts in flight (default: 16)
+ * -r, --sorts: the number of sorts (default: 10000)
+ * -s, --socket: the path of the socket of the daemon (default:
+ *               /tmp/radix.sock)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "headers/service.h"
+
+/* ----- Prototypes ----- */
+static double now(void);
+static void fill(long* keys, long n, unsigned long* state);
+static bool sorted(const long* keys, long n);
+
+/* ----- Time (in seconds) ----- */
+static double now(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* ----- Random keys (xorshift) ----- */
+static void fill(long* keys, long n, unsigned long* state) {
+    long i;
+
+    for(i = 0; i < n; i++) {
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+
+        keys[i] = *state;
+    }
+}
+
+static bool sorted(const long* keys, long n) {
+    long i;
+
+    for(i = 1; i < n; i++)
+        if(keys[i - 1] > keys[i])
+            return false;
+
+    return true;
+}
+
+/* ----- Main ----- */
+int main(int argc, char** argv) {
+    /* ----- Variable declaration ----- */
+    // Command line options
+    long n, inflight, total;
+    int opt;
+    char* path;
+    char* endp;
+    long* value;
+
+    static const struct option options[] = {
+        {"size", required_argument, NULL, 'n'},
+        {"in-flight", required_argument, NULL, 'q'},
+        {"sorts", required_argument, NULL, 'r'},
+        {"socket", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // Sorts
+    service_region region;
+    service_reply reply;
+    unsigned long state;
+    long submitted, done, slot;
+    double start, seconds;
+    int fd;
+
+    /* ----- Verification and get the user parameters ----- */
+    n = 10000;
+    inflight = 16;
+    total = 10000;
+    path = SERVICE_SOCKET;
+
+    while((opt = getopt_long(argc, argv, "n:q:r:s:", options, NULL)) != -1) {
+        switch(opt) {
+            case 'n':
+            case 'q':
+            case 'r':
+                value = opt == 'n' ? &n : (opt == 'q' ? &inflight : &total);
+
+                errno = 0;
+                *value = strtol(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0 || *value <= 0) {
+                    printf("The -%c option should be a strictly positive number.\n", opt);
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 's':
+                path = optarg;
+
+                break;
+
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* ----- Region of the arrays (one per sort in flight) ----- */
+    if((fd = service_connect(path)) == -1) {
+        perror("Error with service_connect");
+
+        exit(errno);
+    }
+
+    if(service_region_create(fd, &region, n * inflight) == -1) {
+        perror("Error with service_region_create");
+
+        exit(errno);
+    }
+
+    state = 88172645463325252UL;
+
+    /* ----- Sorts (a new one in the slot of each one done) ----- */
+    start = now();
+
+    for(submitted = 0; submitted < inflight && submitted < total; submitted++) {
+        fill(&region.keys[submitted * n], n, &state);
+
+        if(service_submit(fd, &region, submitted * n, n, KEY_INT64, submitted) == -1) {
+            perror("Error with service_submit");
+
+            exit(errno);
+        }
+    }
+
+    for(done = 0; done < total; done++) {
+        if(service_wait(fd, &reply) == -1) {
+            printf("The connection to the daemon has been lost.\n");
+
+            return EXIT_FAILURE;
+        }
+
+        // The ID of a sort is its slot
+        slot = reply.id;
+
+        if(reply.status != SERVICE_DONE || !sorted(&region.keys[slot * n], n)) {
+            printf("The sort of the slot %ld failed (status %ld).\n", slot, reply.status);
+
+            return EXIT_FAILURE;
+        }
+
+        if(submitted < total) {
+            fill(&region.keys[slot * n], n, &state);
+
+            if(service_submit(fd, &region, slot * n, n, KEY_INT64, slot) == -1) {
+                perror("Error with service_submit");
+
+                exit(errno);
+            }
+
+            submitted++;
+        }
+    }
+
+    seconds = now() - start;
+
+    printf("%ld sorts of %ld keys in %.3f s: %.0f sorts/s, %.0f keys/s\n", total, n, seconds, total / seconds, total * n / seconds);
+
+    service_region_free(&region);
+
+    close(fd);
+
+    return EXIT_SUCCESS;
+}
@@ -2,8 +2,9 @@
  * File: communication.c
  * Authors: Maxime Meurisse & Valentin Vermeylen
  *
- * This library allows you to manipulate System V's parallel programming
- * mechanisms.
+ * This library allows you to manipulate parallel programming mechanisms:
+ * shared memory (anonymous mappings, optionally backed by huge pages),
+ * atomic counters and barriers (spinning, then sleeping on a futex).
  */
 
 #include "headers/communication.h"
@@ -11,36 +12,38 @@
 /* ----------------------------------- */
 /* ---------- Shared memory ---------- */
 /* ----------------------------------- */
-int shm_create(size_t size, char name) {
+long* shm_map(size_t size, bool huge) {
     assert(size > 0);
 
-    key_t shm_key;
-    int shm_id;
+    long* shm;
 
-    shm_key = ftok(".", name);
+    shm = MAP_FAILED;
 
-    // Create shared memory segment
-    if((shm_id = shmget(shm_key, size, IPC_CREAT | IPC_EXCL | 0666)) == -1) {
-        printf("Shared memory segment exists - opening as client.\n");
+    // A huge page segment is rounded up to a whole number of huge pages
+    if(huge)
+        size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
 
-        // Segment probably already exists - try as client
-        if((shm_id = shmget(shm_key, size, 0)) == -1) {
-            perror("shmget");
+#ifdef MAP_HUGETLB
+    // Explicit huge pages, if some are reserved
+    if(huge)
+        shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
 
-            exit(errno);
-        }
-    }
+    // Anonymous mapping, inherited by the processes forked afterwards
+    if(shm == MAP_FAILED) {
+        shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
 
-    return shm_id;
-}
-
-long* shm_attach(int shm_id) {
-    long* shm;
+        if(shm == MAP_FAILED) {
+            perror("mmap");
 
-    if((shm = (long*)shmat(shm_id, 0, 0)) == (long*)-1) {
-        perror("shmat");
+            exit(errno);
+        }
 
-        exit(errno);
+#ifdef MADV_HUGEPAGE
+        // Otherwise, ask for transparent huge pages
+        if(huge)
+            madvise(shm, size, MADV_HUGEPAGE);
+#endif
     }
 
     return shm;
@@ -48,134 +51,104 @@ long* shm_attach(int shm_id) {
 
 void shm_write(long* shm, size_t index, long value) {
     shm[index] = value;
-
-    fflush(stdout);
 }
 
 long shm_read(long* shm, size_t index) {
     return shm[index];
 }
 
-void shm_remove(int shm_id) {
-    if(shmctl(shm_id, IPC_RMID, 0) == -1) {
-        perror("shmctl");
+void shm_unmap(long* shm, size_t size, bool huge) {
+    assert(shm != NULL);
 
-        exit(errno);
-    }
-}
-
-/* ------------------------------- */
-/* ---------- Semaphore ---------- */
-/* ------------------------------- */
-int sem_create(size_t size, char name) {
-    assert(size > 0);
+    if(huge)
+        size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
 
-    key_t sem_key;
-    int sem_id;
-
-    sem_key = ftok(".", name);
-
-    if((sem_id = semget(sem_key, size, IPC_CREAT | IPC_EXCL | 0666)) == -1) {
-        printf("Semaphore set already exists.\n");
+    if(munmap(shm, size) == -1) {
+        perror("munmap");
 
         exit(errno);
     }
-
-    return sem_id;
 }
 
-void sem_lock(int sem_id, size_t member) {
-    struct sembuf lock = {member, -1, 0};
-
-    if((semop(sem_id, &lock, 1)) == -1) {
-        perror("semop");
-
-        exit(errno);
-    }
+/* -------------------------------------------------- */
+/* ---------- Atomic counters and barriers ---------- */
+/* -------------------------------------------------- */
+long counter_add(long* counter, long value) {
+    return __atomic_fetch_add(counter, value, __ATOMIC_SEQ_CST);
 }
 
-void sem_unlock(int sem_id, size_t member) {
-    struct sembuf unlock = {member, 1, 0};
-
-    if((semop(sem_id, &unlock, 1)) == -1) {
-        perror("semop");
-
-        exit(errno);
-    }
+long counter_get(long* counter) {
+    return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
 }
 
-void sem_remove(int sem_id) {
-    if(semctl(sem_id, 0, IPC_RMID, 0) == -1) {
-        perror("semctl");
-
-        exit(errno);
-    }
+void counter_set(long* counter, long value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELEASE);
 }
 
-/* ----------------------------------- */
-/* ---------- Message queue ---------- */
-/* ----------------------------------- */
-int msgq_create(char name) {
-    key_t msgq_key;
-    int msgq_id;
+barrier* barrier_create(int size) {
+    assert(size > 0);
 
-    msgq_key = ftok(".", name);
-    msgq_id = 0;
+    barrier* b;
 
-    // Open the queue - create if necessary
-    if((msgq_id = msgget(msgq_key, IPC_CREAT | 0660)) == -1) {
-        perror("msgget");
+    b = (barrier*)shm_map(sizeof(barrier), false);
 
-        exit(errno);
-    }
+    b->count = 0;
+    b->sense = 0;
+    b->waiters = 0;
+    b->size = size;
 
-    return msgq_id;
+    return b;
 }
 
-void msgq_send(int msgq_id, message* msg) {
-    assert(msg != NULL);
+int barrier_wait(barrier* b, int* sense) {
+    assert(b != NULL);
+    assert(sense != NULL);
 
-    int length;
+    int spin;
 
-    if(msg == NULL) {
-        perror("msgsnd");
+    // Each participant flips its own sense at every barrier
+    *sense = !*sense;
 
-        exit(errno);
-    }
+    // The last one to arrive resets the counter and releases the others
+    if(counter_add(&b->count, 1) == b->size - 1) {
+        counter_set(&b->count, 0);
 
-    length = sizeof(message) - sizeof(long);
+        __atomic_store_n(&b->sense, *sense, __ATOMIC_SEQ_CST);
 
-    if((msgsnd(msgq_id, msg, length, 0)) == -1) {
-        perror("msgsnd");
+        if(__atomic_load_n(&b->waiters, __ATOMIC_SEQ_CST) > 0)
+            syscall(SYS_futex, &b->sense, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
 
-        exit(errno);
+        return BARRIER_LAST;
     }
-}
-
-void msgq_read(int msgq_id, long type, message* msg) {
-    assert(msg != NULL);
 
-    int length;
+    // Spin briefly, the others are usually not far behind
+    for(spin = 0; spin < BARRIER_SPIN; spin++) {
+        if(__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) == *sense)
+            return BARRIER_SPUN;
 
-    if(msg == NULL) {
-        perror("readmsg");
-
-        exit(errno);
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
     }
 
-    length = sizeof(message) - sizeof(long);
+    // Then sleep until the sense changes
+    __atomic_add_fetch(&b->waiters, 1, __ATOMIC_SEQ_CST);
 
-    if((msgrcv(msgq_id, msg, length, type, 0)) == -1) {
-        perror("readmsg");
+    while(__atomic_load_n(&b->sense, __ATOMIC_SEQ_CST) != *sense) {
+        if(syscall(SYS_futex, &b->sense, FUTEX_WAIT, !*sense, NULL, NULL, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+            perror("futex");
 
-        exit(errno);
+            exit(errno);
+        }
     }
+
+    __atomic_sub_fetch(&b->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return BARRIER_SLEPT;
 }
 
-void msgq_remove(int msgq_id) {
-    if(msgctl(msgq_id, IPC_RMID, 0) == -1) {
-        perror("msgctl");
+void barrier_remove(barrier* b) {
+    assert(b != NULL);
 
-        exit(errno);
-    }
+    shm_unmap((long*)b, sizeof(barrier), false);
 }
@@ -0,0 +1,664 @@
+/*
+ * File: daemon.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * The sort daemon: a long-running process that keeps its workers and its
+ * scratch buffers from one sort to the next, for clients that sort many
+ * arrays (see service.h for the client side).
+ *
+ * The clients write their keys in shared memory regions that the daemon
+ * maps once, and submit the sorts of these keys through a Unix domain
+ * socket. The sorts are queued and taken by the service threads: a small
+ * sort is done by the thread that takes it (with its own scratch buffers),
+ * so that many small sorts run at once, while a larger one is done by all
+ * the workers of a shared context. The keys are sorted in place in the
+ * region, and the client is notified on its socket.
+ *
+ * Compilation
+ * -----------
+ * gcc daemon.c affinity.c array.c communication.c deque.c histogram.c
+ *     pass.c pool.c radix.c trace.c --pedantic -Wall -Wextra
+ *     -Wmissing-prototypes -pthread -lrt -o daemon
+ *
+ * Usage
+ * -----
+ * ./daemon [options]
+ * example: ./daemon -j 8 -c 64M -s /tmp/radix.sock
+ *
+ * Option(s)
+ * ---------
+ * -j, --workers: the number of service threads, and of workers of the
+ *                large sorts (default: the number of online processors)
+ * -b, --bits: the radix is 2^bits (default: 8 bits)
+ * -c, --capacity: the maximal number of keys of a sort (K, M and B stand
+ *                 for thousands, millions and billions, default: 16M)
+ * -s, --socket: the path of the socket (default: /tmp/radix.sock)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "headers/radix.h"
+#include "headers/service.h"
+
+/* Clients connected at once, and regions mapped by each of them */
+#define DAEMON_CLIENTS 64
+#define DAEMON_REGIONS 64
+
+/* Sorts in flight (queued, not taken by a service thread yet) */
+#define DAEMON_QUEUE 4096
+
+/* Largest sort done by a single service thread */
+#define DAEMON_SMALL (1L << 16)
+
+/* ----- Structure declaration ----- */
+// A region mapped for a client
+typedef struct {
+    long* keys;
+    size_t size;
+} mapping;
+
+// A client (its slot is free when its socket is -1)
+typedef struct {
+    int fd;
+    bool closing; // hung up, released once its sorts are done
+    long inflight;
+    mapping regions[DAEMON_REGIONS];
+    int count;
+    char partial[sizeof(service_request)]; // request being read (by the main thread only)
+    size_t received;
+    pthread_mutex_t lock; // state and replies of the client
+} client;
+
+// A sort submitted by a client
+typedef struct {
+    int client;
+    service_request request;
+} job;
+
+typedef struct {
+    client clients[DAEMON_CLIENTS];
+
+    // Sorts to do (circular queue)
+    job queue[DAEMON_QUEUE];
+    long head;
+    long size;
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t emptied;
+
+    // Context of the large sorts, shared by the service threads
+    radix_ctx* large;
+    pthread_mutex_t large_lock;
+
+    radix_opts opts;
+    size_t capacity;
+} daemon_state;
+
+/* ----- Stop requested by a signal ----- */
+static volatile sig_atomic_t stopping = 0;
+
+/* ----- Prototypes ----- */
+static void on_signal(int sig);
+static int reply(client* c, long id, long status);
+static void release(client* c);
+static long region_map(client* c, const service_request* request);
+static void job_run(daemon_state* state, radix_ctx* small, const job* j);
+static void* serve(void* arg);
+
+static void on_signal(int sig) {
+    (void)sig;
+
+    stopping = 1;
+}
+
+/* -------------------------------------- */
+/* ---------- Clients and jobs ---------- */
+/* -------------------------------------- */
+// The lock of the client is held
+static int reply(client* c, long id, long status) {
+    service_reply r;
+    struct pollfd out;
+    size_t sent;
+    ssize_t n;
+
+    r.id = id;
+    r.status = status;
+
+    // The socket is non-blocking: a full one is waited for, as a blocking send would
+    for(sent = 0; sent < sizeof(r); sent += n) {
+        n = send(c->fd, (char*)&r + sent, sizeof(r) - sent, MSG_NOSIGNAL);
+
+        if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            out.fd = c->fd;
+            out.events = POLLOUT;
+
+            poll(&out, 1, -1);
+
+            n = 0;
+
+            continue;
+        }
+
+        // A client that hung up is not an error of the daemon
+        if(n <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// The lock of the client is held, none of its sorts is in flight
+static void release(client* c) {
+    int i;
+
+    for(i = 0; i < c->count; i++)
+        munmap(c->regions[i].keys, c->regions[i].size);
+
+    close(c->fd);
+
+    c->fd = -1;
+    c->count = 0;
+    c->closing = false;
+}
+
+// Index of the new region, or SERVICE_MEMORY
+static long region_map(client* c, const service_request* request) {
+    struct stat info;
+    long* keys;
+    int shm;
+
+    if(c->count == DAEMON_REGIONS || request->size == 0 || request->name[0] != '/' || memchr(request->name, '\0', SERVICE_NAME) == NULL)
+        return SERVICE_MEMORY;
+
+    if((shm = shm_open(request->name, O_RDWR, 0)) == -1)
+        return SERVICE_MEMORY;
+
+    // Past the end of the object, an access would kill the daemon (SIGBUS)
+    if(fstat(shm, &info) == -1 || (size_t)info.st_size < request->size) {
+        close(shm);
+
+        return SERVICE_MEMORY;
+    }
+
+    keys = mmap(NULL, request->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+
+    close(shm);
+
+    if(keys == MAP_FAILED)
+        return SERVICE_MEMORY;
+
+    c->regions[c->count].keys = keys;
+    c->regions[c->count].size = request->size;
+
+    return c->count++;
+}
+
+static void job_run(daemon_state* state, radix_ctx* small, const job* j) {
+    /* ----- Variable declaration ----- */
+    const service_request* r;
+    client* c;
+    long* keys;
+    long status;
+
+    c = &state->clients[j->client];
+    r = &j->request;
+
+    /* ----- Keys of the sort ----- */
+    // The regions of a client with sorts in flight are never unmapped
+    status = SERVICE_DONE;
+    keys = NULL;
+
+    pthread_mutex_lock(&c->lock);
+
+    if(r->region < 0 || r->region >= c->count || r->key < KEY_INT64 || r->key > KEY_DOUBLE)
+        status = SERVICE_INVALID;
+    else if(r->offset > c->regions[r->region].size / sizeof(long) || r->n > c->regions[r->region].size / sizeof(long) - r->offset)
+        status = SERVICE_INVALID;
+    else if(r->n > state->capacity)
+        status = SERVICE_LARGE;
+    else
+        keys = c->regions[r->region].keys + r->offset;
+
+    pthread_mutex_unlock(&c->lock);
+
+    /* ----- Sort in place, by this thread alone or by all the workers ----- */
+    if(status == SERVICE_DONE && r->n > 0) {
+        if((long)r->n <= DAEMON_SMALL) {
+            small->key = r->key;
+
+            radix_run(small, keys, keys, r->n);
+        } else {
+            pthread_mutex_lock(&state->large_lock);
+
+            state->large->key = r->key;
+
+            radix_run(state->large, keys, keys, r->n);
+
+            pthread_mutex_unlock(&state->large_lock);
+        }
+    }
+
+    /* ----- Notification ----- */
+    pthread_mutex_lock(&c->lock);
+
+    if(!c->closing)
+        reply(c, r->id, status);
+
+    if(--c->inflight == 0 && c->closing)
+        release(c);
+
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* ----- Service thread ----- */
+static void* serve(void* arg) {
+    daemon_state* state;
+    radix_opts opts;
+    radix_ctx* small;
+    job j;
+
+    state = arg;
+
+    // The small sorts of this thread (a single worker: the thread itself)
+    opts = state->opts;
+    opts.workers = 1;
+
+    if((small = radix_create(DAEMON_SMALL, &opts)) == NULL) {
+        printf("The scratch buffers of a service thread could not be allocated.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    while(true) {
+        pthread_mutex_lock(&state->lock);
+
+        while(state->size == 0 && !state->stop)
+            pthread_cond_wait(&state->filled, &state->lock);
+
+        if(state->size == 0) {
+            pthread_mutex_unlock(&state->lock);
+
+            break;
+        }
+
+        j = state->queue[state->head];
+        state->head = (state->head + 1) % DAEMON_QUEUE;
+        state->size--;
+
+        pthread_cond_signal(&state->emptied);
+        pthread_mutex_unlock(&state->lock);
+
+        job_run(state, small, &j);
+    }
+
+    radix_destroy(small);
+
+    return NULL;
+}
+
+/* ----- Main ----- */
+int main(int argc, char** argv) {
+    /* ----- Variable declaration ----- */
+    // Command line options
+    int workers, bits, opt;
+    long capacity;
+    char* path;
+    char* endp;
+
+    static const struct option options[] = {
+        {"workers", required_argument, NULL, 'j'},
+        {"bits", required_argument, NULL, 'b'},
+        {"capacity", required_argument, NULL, 'c'},
+        {"socket", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // Service
+    static daemon_state state;
+    struct sockaddr_un address;
+    struct sigaction action;
+    struct pollfd fds[DAEMON_CLIENTS + 1];
+    int slots[DAEMON_CLIENTS + 1];
+    pthread_t* threads;
+    service_request request;
+    client* c;
+    job* j;
+    int listener, fd, nfds, i;
+    long status;
+    ssize_t got;
+
+    /* ----- Verification and get the user parameters ----- */
+    workers = 0;
+    bits = 8;
+    capacity = 16000000;
+    path = SERVICE_SOCKET;
+
+    while((opt = getopt_long(argc, argv, "j:b:c:s:", options, NULL)) != -1) {
+        switch(opt) {
+            case 'j':
+                errno = 0;
+                workers = strtol(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0 || workers <= 0) {
+                    printf("The number of workers should be a strictly positive number.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'b':
+                errno = 0;
+                bits = strtol(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0 || bits <= 0 || bits > 24) {
+                    printf("The number of bits should be between 1 and 24.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'c':
+                errno = 0;
+                capacity = strtol(optarg, &endp, 10);
+
+                switch(*endp) {
+                    case 'B': case 'b': case 'G': case 'g':
+                        capacity *= 1000;
+                        /* fall through */
+                    case 'M': case 'm':
+                        capacity *= 1000;
+                        /* fall through */
+                    case 'K': case 'k':
+                        capacity *= 1000;
+                        endp++;
+                        break;
+                }
+
+                if(errno != 0 || strlen(endp) > 0 || capacity <= 0) {
+                    printf("The capacity should be a strictly positive number.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 's':
+                path = optarg;
+
+                break;
+
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(workers == 0 && (workers = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        workers = 1;
+
+    if(strlen(path) >= sizeof(address.sun_path)) {
+        printf("The path of the socket is too long.\n");
+
+        return EXIT_FAILURE;
+    }
+
+    /* ----- Warm workers and scratch buffers ----- */
+    radix_opts_init(&state.opts);
+
+    state.opts.bits = bits;
+    state.opts.workers = workers;
+    state.opts.threads = true;
+    state.capacity = capacity;
+
+    if((state.large = radix_create(capacity, &state.opts)) == NULL) {
+        printf("The scratch buffers of the large sorts could not be allocated.\n");
+
+        return EXIT_FAILURE;
+    }
+
+    for(i = 0; i < DAEMON_CLIENTS; i++) {
+        state.clients[i].fd = -1;
+        state.clients[i].closing = false;
+        state.clients[i].inflight = 0;
+        state.clients[i].count = 0;
+
+        pthread_mutex_init(&state.clients[i].lock, NULL);
+    }
+
+    state.head = 0;
+    state.size = 0;
+    state.stop = false;
+
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_mutex_init(&state.large_lock, NULL);
+    pthread_cond_init(&state.filled, NULL);
+    pthread_cond_init(&state.emptied, NULL);
+
+    if((threads = malloc(workers * sizeof(pthread_t))) == NULL) {
+        perror("Error with malloc");
+
+        exit(errno);
+    }
+
+    for(i = 0; i < workers; i++) {
+        if((errno = pthread_create(&threads[i], NULL, serve, &state)) != 0) {
+            perror("Error with pthread_create");
+
+            exit(errno);
+        }
+    }
+
+    /* ----- Socket ----- */
+    // A signal interrupts the wait for the clients (no restart)
+    memset(&action, 0, sizeof(action));
+
+    action.sa_handler = on_signal;
+
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    memset(&address, 0, sizeof(address));
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if((listener = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        perror("Error with socket");
+
+        exit(errno);
+    }
+
+    // The socket of a previous daemon
+    unlink(path);
+
+    if(bind(listener, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(listener, DAEMON_CLIENTS) == -1) {
+        perror("Error with bind");
+
+        exit(errno);
+    }
+
+    printf("Listening on %s (%d workers, %s kernel).\n", path, workers, state.large->kernel_name);
+    fflush(stdout);
+
+    /* ----- Requests of the clients ----- */
+    while(!stopping) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        nfds = 1;
+
+        for(i = 0; i < DAEMON_CLIENTS; i++) {
+            c = &state.clients[i];
+
+            pthread_mutex_lock(&c->lock);
+
+            if(c->fd != -1 && !c->closing) {
+                fds[nfds].fd = c->fd;
+                fds[nfds].events = POLLIN;
+                slots[nfds++] = i;
+            }
+
+            pthread_mutex_unlock(&c->lock);
+        }
+
+        if(poll(fds, nfds, -1) == -1) {
+            if(errno == EINTR)
+                continue;
+
+            perror("Error with poll");
+
+            exit(errno);
+        }
+
+        /* ----- New client (in a free slot) ----- */
+        if(fds[0].revents & POLLIN) {
+            // A client never blocks the others: its requests are read as they come
+            if((fd = accept(listener, NULL, NULL)) == -1 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+                perror("Error with accept");
+
+                if(fd != -1)
+                    close(fd);
+            } else {
+                for(i = 0; i < DAEMON_CLIENTS; i++) {
+                    c = &state.clients[i];
+
+                    pthread_mutex_lock(&c->lock);
+
+                    if(c->fd == -1) {
+                        c->fd = fd;
+                        c->received = 0;
+                        fd = -1;
+                    }
+
+                    pthread_mutex_unlock(&c->lock);
+
+                    if(fd == -1)
+                        break;
+                }
+
+                // Too many clients
+                if(fd != -1)
+                    close(fd);
+            }
+        }
+
+        /* ----- Requests ----- */
+        for(i = 1; i < nfds; i++) {
+            if(fds[i].revents == 0)
+                continue;
+
+            c = &state.clients[slots[i]];
+
+            got = recv(fds[i].fd, c->partial + c->received, sizeof(request) - c->received, 0);
+
+            if(got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                continue;
+
+            // Hung up: the client is released once its sorts are done
+            if(got <= 0) {
+                pthread_mutex_lock(&c->lock);
+
+                c->closing = true;
+
+                if(c->inflight == 0)
+                    release(c);
+
+                pthread_mutex_unlock(&c->lock);
+
+                continue;
+            }
+
+            // Only a whole request is handled, the rest of it comes with the next reads
+            c->received += got;
+
+            if(c->received < sizeof(request))
+                continue;
+
+            memcpy(&request, c->partial, sizeof(request));
+
+            c->received = 0;
+
+            if(request.type == SERVICE_MAP) {
+                pthread_mutex_lock(&c->lock);
+
+                status = region_map(c, &request);
+
+                reply(c, request.id, status);
+
+                pthread_mutex_unlock(&c->lock);
+
+                continue;
+            }
+
+            if(request.type != SERVICE_SORT) {
+                pthread_mutex_lock(&c->lock);
+
+                reply(c, request.id, SERVICE_INVALID);
+
+                pthread_mutex_unlock(&c->lock);
+
+                continue;
+            }
+
+            pthread_mutex_lock(&c->lock);
+
+            c->inflight++;
+
+            pthread_mutex_unlock(&c->lock);
+
+            // Queued (the clients wait while the queue is full)
+            pthread_mutex_lock(&state.lock);
+
+            while(state.size == DAEMON_QUEUE)
+                pthread_cond_wait(&state.emptied, &state.lock);
+
+            j = &state.queue[(state.head + state.size) % DAEMON_QUEUE];
+            j->client = slots[i];
+            j->request = request;
+
+            state.size++;
+
+            pthread_cond_signal(&state.filled);
+            pthread_mutex_unlock(&state.lock);
+        }
+    }
+
+    /* ----- Stop (once the queued sorts are done) ----- */
+    pthread_mutex_lock(&state.lock);
+
+    state.stop = true;
+
+    pthread_cond_broadcast(&state.filled);
+    pthread_mutex_unlock(&state.lock);
+
+    for(i = 0; i < workers; i++)
+        pthread_join(threads[i], NULL);
+
+    for(i = 0; i < DAEMON_CLIENTS; i++)
+        if(state.clients[i].fd != -1)
+            release(&state.clients[i]);
+
+    close(listener);
+    unlink(path);
+
+    free(threads);
+
+    radix_destroy(state.large);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/*
+ * File: deque.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the work-stealing deques of the MSD sort: each
+ * worker pushes and pops the buckets it has to sort at the bottom of its
+ * own deque, the idle workers steal them at the top of the others. The
+ * deques only use atomic operations, so they can be shared by forked
+ * processes as well as by threads.
+ */
+
+#include "headers/deque.h"
+
+void deque_init(deque* d, task* tasks, long size) {
+    assert(d != NULL);
+    assert(tasks != NULL);
+    assert(size > 0);
+
+    d->top = 0;
+    d->bottom = 0;
+    d->size = size;
+    d->tasks = tasks;
+}
+
+bool deque_push(deque* d, const task* t) {
+    long b, top;
+
+    b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+
+    // A slot is only reused once its task can not be stolen anymore
+    if(b - top >= d->size)
+        return false;
+
+    d->tasks[b % d->size] = *t;
+
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool deque_pop(deque* d, task* t) {
+    long b, top;
+    bool taken;
+
+    b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if(top > b) {
+        // Empty
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+
+        return false;
+    }
+
+    *t = d->tasks[b % d->size];
+    taken = true;
+
+    // The last task may be stolen at the same time
+    if(top == b) {
+        taken = __atomic_compare_exchange_n(&d->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return taken;
+}
+
+bool deque_steal(deque* d, task* t) {
+    long b, top;
+
+    top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if(top >= b)
+        return false;
+
+    *t = d->tasks[top % d->size];
+
+    return __atomic_compare_exchange_n(&d->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
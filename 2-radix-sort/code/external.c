@@ -0,0 +1,378 @@
+/*
+ * File: external.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements an external (out-of-core) sort for arrays that
+ * do not fit in memory: the input is sorted by runs with the parallel
+ * radix sort, the runs are spilled to temporary files and merged.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "headers/external.h"
+#include "headers/io.h"
+
+/* Size (in numbers) of the blocks formatted at once in a text output */
+#define TEXT_BLOCK 65536
+
+/* Maximal length of a formatted number (sign, 17 digits, point, exponent
+ * and newline, for a double) */
+#define TEXT_WIDTH 25
+
+/* Minimal size (in numbers) of the read buffer of a run */
+#define RUN_BUFFER 65536
+
+/* ----- Structure declaration ----- */
+typedef struct {
+    int fd;
+    long* buffer;
+    size_t size;      // capacity of the buffer
+    size_t count;     // numbers in the buffer
+    size_t pos;       // next number to merge in the buffer
+    size_t remaining; // numbers of the run still in the file
+} run;
+
+/* ----- Prototypes ----- */
+static void write_all(int fd, const void* buffer, size_t length);
+static void write_numbers(int fd, const long* numbers, size_t size, bool binary, char* text, key_type key);
+static int spill(const long* numbers, size_t size, const char* tmpdir);
+static bool run_fill(run* r);
+static void heap_down(run* runs, int* heap, int size, int i, key_type key);
+
+/* ----------------------------- */
+/* ---------- Writing ---------- */
+/* ----------------------------- */
+static void write_all(int fd, const void* buffer, size_t length) {
+    const char* data;
+    ssize_t written;
+
+    data = buffer;
+
+    while(length > 0) {
+        if((written = write(fd, data, length)) == -1) {
+            if(errno == EINTR)
+                continue;
+
+            perror("write");
+
+            exit(errno);
+        }
+
+        data += written;
+        length -= written;
+    }
+}
+
+static void write_numbers(int fd, const long* numbers, size_t size, bool binary, char* text, key_type key) {
+    size_t n;
+
+    if(binary && key_size(key) == sizeof(long)) {
+        write_all(fd, numbers, size * sizeof(long));
+
+        return;
+    }
+
+    // Text (or 32-bit keys) is formatted by blocks in a buffer of TEXT_BLOCK * TEXT_WIDTH bytes
+    while(size > 0) {
+        n = size < TEXT_BLOCK ? size : TEXT_BLOCK;
+
+        if(binary) {
+            binary_narrow(text, numbers, n, key);
+            write_all(fd, text, n * key_size(key));
+        } else {
+            write_all(fd, text, text_format(text, numbers, n, key));
+        }
+
+        numbers += n;
+        size -= n;
+    }
+}
+
+static int spill(const long* numbers, size_t size, const char* tmpdir) {
+    char* path;
+    int fd;
+
+    path = malloc(strlen(tmpdir) + sizeof("/radix-XXXXXX"));
+
+    if(path == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    sprintf(path, "%s/radix-XXXXXX", tmpdir);
+
+    if((fd = mkstemp(path)) == -1) {
+        perror("mkstemp");
+
+        exit(errno);
+    }
+
+    // The file disappears as soon as it is closed
+    unlink(path);
+    free(path);
+
+    write_all(fd, numbers, size * sizeof(long));
+
+    if(lseek(fd, 0, SEEK_SET) == -1) {
+        perror("lseek");
+
+        exit(errno);
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return fd;
+}
+
+/* ----------------------------- */
+/* ---------- Merging ---------- */
+/* ----------------------------- */
+static bool run_fill(run* r) {
+    size_t length, done;
+    ssize_t n;
+
+    if(r->remaining == 0)
+        return false;
+
+    length = (r->remaining < r->size ? r->remaining : r->size) * sizeof(long);
+    done = 0;
+
+    while(done < length) {
+        if((n = read(r->fd, (char*)r->buffer + done, length - done)) <= 0) {
+            if(n == -1 && errno == EINTR)
+                continue;
+
+            perror("read");
+
+            exit(n == 0 ? EXIT_FAILURE : errno);
+        }
+
+        done += n;
+    }
+
+    r->count = length / sizeof(long);
+    r->pos = 0;
+    r->remaining -= r->count;
+
+    return true;
+}
+
+static void heap_down(run* runs, int* heap, int size, int i, key_type key) {
+    int smallest, child, tmp;
+    unsigned long head;
+
+    while(true) {
+        smallest = i;
+
+        // The heads are compared in the order of their encoded keys
+        for(child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++) {
+            head = key_encode(runs[heap[child]].buffer[runs[heap[child]].pos], key);
+
+            if(head < key_encode(runs[heap[smallest]].buffer[runs[heap[smallest]].pos], key))
+                smallest = child;
+        }
+
+        if(smallest == i)
+            return;
+
+        tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+
+        i = smallest;
+    }
+}
+
+/* ---------------------------------- */
+/* ---------- External sort ---------- */
+/* ---------------------------------- */
+int external_sort(const char* map, size_t length, const char* output, bool binary, size_t memory, const radix_opts* opts, const char* tmpdir) {
+    assert(map != NULL);
+    assert(output != NULL);
+
+    /* ----- Variable declaration ----- */
+    // Runs
+    run* runs;
+    int* heap;
+    int nb_runs, size, r;
+    key_type key;
+
+    // Radix sort of the runs
+    radix_ctx* ctx;
+
+    // Input and output
+    size_t capacity, offset, end, n, i, lines, page;
+    long* numbers;
+    long* sorted;
+    long* out;
+    char* text;
+    int fd;
+
+    key = opts != NULL ? opts->key : KEY_INT64;
+
+    /* ----- Sorting the runs ----- */
+    // The radix sort needs two scratch buffers of *capacity* numbers
+    capacity = memory / (2 * sizeof(long));
+
+    if(capacity == 0)
+        capacity = 1;
+
+    if((ctx = radix_create(capacity, opts)) == NULL || radix_buffer(ctx) == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    text = malloc(TEXT_BLOCK * TEXT_WIDTH);
+
+    if(text == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    if((fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1) {
+        perror("open");
+
+        exit(errno);
+    }
+
+    page = sysconf(_SC_PAGESIZE);
+
+    runs = NULL;
+    nb_runs = 0;
+    offset = 0;
+
+    while(offset < length) {
+        // Retrieve the next *capacity* numbers of the input
+        if(binary) {
+            n = (length - offset) / key_size(key);
+            n = n < capacity ? n : capacity;
+            end = offset + n * key_size(key);
+
+            // 32-bit keys are widened, 64-bit ones are sorted from the mapping
+            if(key_size(key) == sizeof(long)) {
+                numbers = (long*)(map + offset);
+            } else {
+                numbers = radix_buffer(ctx);
+
+                binary_widen(map + offset, numbers, n, key);
+            }
+        } else {
+            for(end = offset, lines = 0; end < length && lines < capacity; end++)
+                if(map[end] == '\n')
+                    lines++;
+
+            n = text_count(map + offset, end - offset);
+            numbers = radix_buffer(ctx);
+
+            if(text_parse(map + offset, end - offset, numbers, key, ctx->workers) == -1) {
+                radix_destroy(ctx);
+                free(text);
+                close(fd);
+
+                return -1;
+            }
+        }
+
+        sorted = radix_run(ctx, numbers, NULL, n);
+
+        // The consumed part of the input is not needed anymore
+        madvise((char*)map + offset / page * page, (end - offset / page * page) / page * page, MADV_DONTNEED);
+
+        if(offset == 0 && end == length) {
+            // Everything fits in one run, there is nothing to merge
+            write_numbers(fd, sorted, n, binary, text, key);
+        } else {
+            runs = realloc(runs, (nb_runs + 1) * sizeof(run));
+
+            if(runs == NULL) {
+                printf("Error with realloc.\n");
+
+                exit(EXIT_FAILURE);
+            }
+
+            runs[nb_runs].fd = spill(sorted, n, tmpdir);
+            runs[nb_runs].remaining = n;
+
+            nb_runs++;
+        }
+
+        offset = end;
+    }
+
+    // Give back the memory of the radix sort before merging
+    radix_destroy(ctx);
+
+    /* ----- Merging the runs ----- */
+    if(nb_runs > 0) {
+        // The memory budget is shared between the runs and the output
+        n = memory / ((nb_runs + 1) * sizeof(long));
+        n = n < RUN_BUFFER ? RUN_BUFFER : n;
+
+        heap = malloc(nb_runs * sizeof(int));
+        out = malloc(n * sizeof(long));
+
+        if(heap == NULL || out == NULL) {
+            printf("Error with malloc.\n");
+
+            exit(EXIT_FAILURE);
+        }
+
+        size = 0;
+
+        for(r = 0; r < nb_runs; r++) {
+            runs[r].size = n;
+            runs[r].buffer = malloc(n * sizeof(long));
+
+            if(runs[r].buffer == NULL) {
+                printf("Error with malloc.\n");
+
+                exit(EXIT_FAILURE);
+            }
+
+            run_fill(&runs[r]);
+            heap[size++] = r;
+        }
+
+        for(r = size / 2 - 1; r >= 0; r--)
+            heap_down(runs, heap, size, r, key);
+
+        // Always output the smallest head of the runs
+        i = 0;
+
+        while(size > 0) {
+            r = heap[0];
+            out[i++] = runs[r].buffer[runs[r].pos++];
+
+            if(i == n) {
+                write_numbers(fd, out, i, binary, text, key);
+                i = 0;
+            }
+
+            if(runs[r].pos == runs[r].count && !run_fill(&runs[r])) {
+                heap[0] = heap[--size];
+
+                close(runs[r].fd);
+                free(runs[r].buffer);
+            }
+
+            heap_down(runs, heap, size, 0, key);
+        }
+
+        write_numbers(fd, out, i, binary, text, key);
+
+        free(heap);
+        free(out);
+        free(runs);
+    }
+
+    free(text);
+    close(fd);
+
+    return nb_runs > 0 ? nb_runs : 1;
+}
@@ -0,0 +1,116 @@
+/*
+ * File: affinity.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library allows the placement of the workers and of their memory:
+ * pinning a worker to a processor, touching its part of the buffers first
+ * (so that the kernel allocates its pages on the NUMA node of the worker)
+ * and reporting on which node the pages of a buffer are.
+ */
+
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+
+/* Maximal number of NUMA nodes in a report */
+#define AFFINITY_NODES 64
+
+/* Processors a thread may run on (as many as in a cpu_set_t) */
+#define AFFINITY_WORDS (1024 / (8 * sizeof(unsigned long)))
+
+typedef struct {
+    unsigned long words[AFFINITY_WORDS];
+} affinity_mask;
+
+/*
+ * This function returns the processor of a worker: the workers are given,
+ * in order, the processors the process is allowed to run on (in turn if
+ * there are more workers than processors).
+ *
+ * Parameter(s)
+ * ------------
+ * id: the ID of the worker
+ *
+ * Return
+ * ------
+ * The number of the processor, or -1 if it can not be known.
+ */
+int affinity_cpu(int id);
+
+/*
+ * This function pins the calling thread (or process) to a processor.
+ *
+ * Parameter(s)
+ * ------------
+ * cpu: the number of the processor (nothing is done if it is negative)
+ */
+void affinity_pin(int cpu);
+
+/*
+ * This function saves the processors the calling thread may run on.
+ *
+ * Parameter(s)
+ * ------------
+ * mask: where to save them
+ *
+ * Return
+ * ------
+ * 0 if they have been saved, -1 otherwise.
+ */
+int affinity_save(affinity_mask* mask);
+
+/*
+ * This function lets the calling thread run again on the processors
+ * saved by affinity_save.
+ *
+ * Parameter(s)
+ * ------------
+ * mask: the saved processors
+ */
+void affinity_restore(const affinity_mask* mask);
+
+/*
+ * This function returns the NUMA node the calling thread is running on.
+ *
+ * Return
+ * ------
+ * The number of the node, or -1 if it can not be known.
+ */
+int affinity_node(void);
+
+/*
+ * This function writes in every page of a part of a buffer, so that the
+ * pages not allocated yet are allocated on the node of the caller.
+ *
+ * Parameter(s)
+ * ------------
+ * buffer: the buffer
+ * begin: the beginning of the part (in numbers)
+ * end: the end of the part (in numbers, excluded)
+ */
+void affinity_touch(long* buffer, size_t begin, size_t end);
+
+/*
+ * This function counts the pages of a buffer on each NUMA node (the pages
+ * are read, so the pages of a shared mapping touched by other processes
+ * are mapped in the caller).
+ *
+ * Parameter(s)
+ * ------------
+ * buffer: the buffer
+ * size: the size of the buffer (in bytes)
+ * pages: the array where to count the pages of each node (of size
+ *        AFFINITY_NODES), set by the function
+ *
+ * Return
+ * ------
+ * The number of pages whose node can not be known (e.g. not allocated).
+ */
+long affinity_pages(long* buffer, size_t size, long* pages);
+
+#endif
@@ -2,8 +2,9 @@
  * File: communication.h
  * Authors: Maxime Meurisse & Valentin Vermeylen
  *
- * This library allows you to manipulate System V's parallel programming
- * mechanisms.
+ * This library allows you to manipulate parallel programming mechanisms:
+ * shared memory (anonymous mappings, optionally backed by huge pages),
+ * atomic counters and barriers (spinning, then sleeping on a futex).
  */
 
 #ifndef _COMMUNICATION_H_
@@ -11,52 +12,56 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <assert.h>
 #include <errno.h>
+#include <unistd.h>
 
-#include <sys/ipc.h>
 #include <sys/types.h>
-#include <sys/shm.h>
-#include <sys/sem.h>
-#include <sys/msg.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
+/* A barrier shared by several processes (in a shared memory segment) */
 typedef struct {
-    long mtype;
-    long digit;
-    long num_numbers;
-    long write_pos;
-} message;
+    long count;   // participants arrived at the barrier
+    int sense;    // flipped each time the barrier is released
+    int waiters;  // participants sleeping on the sense
+    int size;     // number of participants
+} barrier;
+
+/* Number of checks of a barrier before sleeping */
+#define BARRIER_SPIN 1024
+
+/* How a participant waited at a barrier */
+#define BARRIER_LAST 0
+#define BARRIER_SPUN 1
+#define BARRIER_SLEPT 2
+
+/* Size of an explicit huge page (the mappings are rounded up to it) */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
 /* ----------------------------------- */
 /* ---------- Shared memory ---------- */
 /* ----------------------------------- */
 
 /*
- * This function creates a shared memory segment.
+ * This function creates a shared memory segment, as an anonymous shared
+ * mapping. It is shared with the processes forked afterwards only, so
+ * several sorts never attach to each other's segments.
  *
  * Parameter(s)
  * ------------
  * size: the size of the shared memory segment
- * name: the unique name of the shared memory segment
- *
- * Return
- * ------
- * The ID of the shared memory segment.
- */
-int shm_create(size_t size, char name);
-
-/*
- * This function attaches a shared memory segment to a pointer.
- *
- * Parameter(s)
- * ------------
- * shm_id: the ID of the shared memory segment
+ * huge: true to back the segment with huge pages (explicit ones if some
+ *       are reserved, transparent ones otherwise)
  *
  * Return
  * ------
  * A pointer to the shared memory segment.
  */
-long* shm_attach(int shm_id);
+long* shm_map(size_t size, bool huge);
 
 /*
  * This function allows to write a value in the shared memory segment
@@ -86,108 +91,97 @@ void shm_write(long* shm, size_t index, long value);
 long shm_read(long* shm, size_t index);
 
 /*
- * This function allows to mark for deletion a shared memory segment.
+ * This function unmaps a shared memory segment created by shm_map.
  *
  * Parameter(s)
  * ------------
- * shm_id: the ID of the shared memory segment to delete
+ * shm: a pointer to the shared memory segment
+ * size: the size of the shared memory segment
+ * huge: the value given to shm_map
  */
-void shm_remove(int shm_id);
+void shm_unmap(long* shm, size_t size, bool huge);
 
-/* ------------------------------- */
-/* ---------- Semaphore ---------- */
-/* ------------------------------- */
+/* -------------------------------------------------- */
+/* ---------- Atomic counters and barriers ---------- */
+/* -------------------------------------------------- */
 
 /*
- * This functio allows to create a set of semaphores.
+ * This function atomically adds a value to a counter (which may be in a
+ * shared memory segment).
  *
  * Parameter(s)
  * ------------
- * size: the size of the set of semaphores
- * name: the unique name of the set of semaphores
+ * counter: a pointer to the counter
+ * value: the value to add
  *
  * Return
  * ------
- * The ID of the set of semaphores.
+ * The value of the counter before the addition.
  */
-int sem_create(size_t size, char name);
+long counter_add(long* counter, long value);
 
 /*
- * This function decrements the semaphore if its value is > 0 or block
- * the process if not.
+ * This function atomically reads a counter.
  *
  * Parameter(s)
  * ------------
- * sem_id: the ID of the set of semaphores
- * member: the index of the semaphore to lock in the set
- */
-void sem_lock(int sem_id, size_t member);
-
-/*
- * This function increment the semaphore.
+ * counter: a pointer to the counter
  *
- * Parameter(s)
- * ------------
- * sem_id: the ID of the set of semaphores
- * member: the index of the semaphore to increment in the set
+ * Return
+ * ------
+ * The value of the counter.
  */
-void sem_unlock(int sem_id, size_t member);
+long counter_get(long* counter);
 
 /*
- * This function allows to mark for deletion a set of semaphores.
+ * This function atomically sets a counter.
  *
  * Parameter(s)
  * ------------
- * sem_id: the ID of the set of semaphores to delete
+ * counter: a pointer to the counter
+ * value: the new value of the counter
  */
-void sem_remove(int sem_id);
-
-/* ----------------------------------- */
-/* ---------- Message queue ---------- */
-/* ----------------------------------- */
+void counter_set(long* counter, long value);
 
 /*
- * This function creates a message queue.
+ * This function creates a sense-reversing barrier in a shared memory
+ * segment, for the processes forked afterwards.
  *
  * Parameter(s)
  * ------------
- * name: the name of the message queue
+ * size: the number of participants
  *
  * Return
  * ------
- * The ID of the message queue.
+ * A pointer to the barrier.
  */
-int msgq_create(char name);
+barrier* barrier_create(int size);
 
 /*
- * This function allows to send a message throw a message queue.
+ * This function blocks until all participants have reached the barrier.
+ * The caller spins for a short time, then sleeps on a futex; the last
+ * participant to arrive wakes up the sleeping ones (if any), so a barrier
+ * costs no system call when the participants arrive close together.
  *
  * Parameter(s)
  * ------------
- * msgq_id: the ID of the message queue
- * msg: the message to send
- */
-void msgq_send(int msgq_id, message* msg);
-
-/*
- * This function read a message from a message queue and remove it. If
- * there is no message, the process is blocked.
+ * b: the barrier
+ * sense: the local sense of the participant (initialized to 0)
  *
- * Parameter(s)
- * ------------
- * msgq_id: the ID of the message queue
- * type: the type of the message
- * msg: the read message
+ * Return
+ * ------
+ * How the caller waited: BARRIER_LAST (it arrived last), BARRIER_SPUN or
+ * BARRIER_SLEPT.
  */
-void msgq_read(int msgq_id, long type, message* msg);
+int barrier_wait(barrier* b, int* sense);
 
 /*
- * This function allows to mark for deletion a message queue.
+ * This function removes a barrier.
  *
  * Parameter(s)
  * ------------
- * msgq_id: the ID of the message queue to delete
+ * b: the barrier to remove
  */
-void msgq_remove(int msgq_id);
+void barrier_remove(barrier* b);
 
 #endif
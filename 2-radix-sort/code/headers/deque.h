@@ -0,0 +1,91 @@
+/*
+ * File: deque.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the work-stealing deques of the MSD sort: each
+ * worker pushes and pops the buckets it has to sort at the bottom of its
+ * own deque, the idle workers steal them at the top of the others. The
+ * deques only use atomic operations, so they can be shared by forked
+ * processes as well as by threads.
+ */
+
+#ifndef _DEQUE_H_
+#define _DEQUE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* A bucket to sort */
+typedef struct {
+    long begin;
+    long end;
+    int level;  // index of the digit to sort on (from the least significant)
+    int buffer; // scratch buffer holding the bucket
+} task;
+
+typedef struct {
+    long top;    // next task to steal
+    long bottom; // next free slot
+    long size;
+    task* tasks; // circular array of *size* tasks
+} deque;
+
+/*
+ * This function initializes an empty deque.
+ *
+ * Parameter(s)
+ * ------------
+ * d: the deque
+ * tasks: the array of the tasks (shared with the other workers)
+ * size: the size of the array
+ */
+void deque_init(deque* d, task* tasks, long size);
+
+/*
+ * This function pushes a task at the bottom of a deque (only by its
+ * owner).
+ *
+ * Parameter(s)
+ * ------------
+ * d: the deque
+ * t: the task
+ *
+ * Return
+ * ------
+ * true if the task has been pushed, false if the deque is full.
+ */
+bool deque_push(deque* d, const task* t);
+
+/*
+ * This function pops the task at the bottom of a deque (only by its
+ * owner).
+ *
+ * Parameter(s)
+ * ------------
+ * d: the deque
+ * t: where to write the task
+ *
+ * Return
+ * ------
+ * true if a task has been popped, false if the deque is empty.
+ */
+bool deque_pop(deque* d, task* t);
+
+/*
+ * This function steals the task at the top of a deque (by any worker).
+ *
+ * Parameter(s)
+ * ------------
+ * d: the deque
+ * t: where to write the task
+ *
+ * Return
+ * ------
+ * true if a task has been stolen, false if the deque is empty or if
+ * another worker took the task first.
+ */
+bool deque_steal(deque* d, task* t);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * File: external.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements an external (out-of-core) sort for arrays that
+ * do not fit in memory: the input is sorted by runs with the parallel
+ * radix sort, the runs are spilled to temporary files and merged.
+ */
+
+#ifndef _EXTERNAL_H_
+#define _EXTERNAL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "radix.h"
+
+/*
+ * This function sorts the numbers of a mapped input file and writes them
+ * in an output file, using at most (about) *memory* bytes of memory.
+ *
+ * Parameter(s)
+ * ------------
+ * map: the mapping of the input file
+ * length: the length of the input file (in bytes)
+ * output: the path of the output file
+ * binary: true for raw keys (see key.h), false for one number per line
+ * memory: the memory budget (in bytes)
+ * opts: the options of the radix sort of the runs (and the type of the
+ *       keys)
+ * tmpdir: the directory where to write the runs
+ *
+ * Return
+ * ------
+ * The number of runs, or -1 if the input contains an invalid number.
+ */
+int external_sort(const char* map, size_t length, const char* output, bool binary, size_t memory, const radix_opts* opts, const char* tmpdir);
+
+#endif
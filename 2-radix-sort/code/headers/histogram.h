@@ -0,0 +1,81 @@
+/*
+ * File: histogram.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the counting of the digits of an array of keys
+ * (the histogram of a pass), with a kernel chosen at runtime among the
+ * ones the processor supports (AVX-512, AVX2, SSE4.1 or scalar). The
+ * digits are extracted several keys at a time and counted in several
+ * tables (ways) in turn, so that repeated digits do not wait for each
+ * other's increment.
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* Number of tables the digits are counted in */
+#define HISTOGRAM_WAYS 4
+
+/* Digit of a key: ((key ^ flip) - min) >> shift & mask */
+#define HISTOGRAM_DIGIT(k, d) (((((unsigned long)(k) ^ (d)->flip) - (d)->min) >> (d)->shift) & (d)->mask)
+
+/* Extraction of a digit */
+typedef struct {
+    unsigned long flip; // bits flipped first (the sign bit of signed keys)
+    unsigned long min;  // then subtracted
+    int shift;
+    unsigned long mask; // the base minus one (a power of two)
+} histogram_digit;
+
+/* A kernel: counts the digits of *n* keys in HISTOGRAM_WAYS tables of mask + 1 counts */
+typedef void (*histogram_kernel)(const long* keys, size_t n, const histogram_digit* digit, long* ways);
+
+/*
+ * This function returns the fastest kernel supported by the processor.
+ *
+ * Parameter(s)
+ * ------------
+ * name: where to write the name of the kernel (if not NULL)
+ *
+ * Return
+ * ------
+ * The kernel.
+ */
+histogram_kernel histogram_select(const char** name);
+
+/*
+ * This function counts the digits of an array of keys with a kernel and
+ * adds them to a histogram.
+ *
+ * Parameter(s)
+ * ------------
+ * kernel: the kernel
+ * keys: the keys
+ * n: the number of keys
+ * digit: the extraction of the digit
+ * ways: HISTOGRAM_WAYS * (mask + 1) counts used by the kernel
+ * counts: the histogram (of mask + 1 counts)
+ */
+void histogram_count(histogram_kernel kernel, const long* keys, size_t n, const histogram_digit* digit, long* ways, long* counts);
+
+/*
+ * This function checks every kernel supported by the processor against
+ * the scalar one, on random keys and digits.
+ *
+ * Parameter(s)
+ * ------------
+ * out: where to report the result of each kernel
+ *
+ * Return
+ * ------
+ * 0 if all the kernels give the same histograms as the scalar one, -1
+ * otherwise.
+ */
+int histogram_check(FILE* out);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * File: io.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library allows the reading and the writing of arrays of numbers
+ * from and to files, through memory mappings (raw binary files of 64-bit
+ * words or text files with one number per line). The text of a number
+ * depends on the type of the keys (see key.h). Large texts are parsed and
+ * formatted by several workers.
+ */
+
+#ifndef _IO_H_
+#define _IO_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "key.h"
+
+/* Maximal length of the text of a number (e.g. -2.2250738585072014e-308) */
+#define TEXT_TOKEN 64
+
+/*
+ * This function maps a whole file in memory, in read-only mode.
+ *
+ * Parameter(s)
+ * ------------
+ * path: the path of the file to map
+ * length: the length of the file (in bytes), set by the function
+ *
+ * Return
+ * ------
+ * A pointer to the mapping, or NULL if the file is empty.
+ */
+void* file_map(const char* path, size_t* length);
+
+/*
+ * This function creates (or truncates) a file of a given length and maps
+ * it in memory, in read-write mode. Everything written in the mapping is
+ * written in the file.
+ *
+ * Parameter(s)
+ * ------------
+ * path: the path of the file to create
+ * length: the length of the file (in bytes)
+ *
+ * Return
+ * ------
+ * A pointer to the mapping.
+ */
+void* file_create(const char* path, size_t length);
+
+/*
+ * This function creates (or truncates) a file and opens it for writing.
+ *
+ * Parameter(s)
+ * ------------
+ * path: the path of the file to create
+ *
+ * Return
+ * ------
+ * The file descriptor of the file.
+ */
+int file_open(const char* path);
+
+/*
+ * This function unmaps a file mapped by file_map or file_create.
+ *
+ * Parameter(s)
+ * ------------
+ * map: the pointer to the mapping
+ * length: the length of the mapping (in bytes)
+ */
+void file_unmap(void* map, size_t length);
+
+/*
+ * This function counts the numbers of a text (one number per line, the
+ * last line may or may not end with a newline).
+ *
+ * Parameter(s)
+ * ------------
+ * text: the text
+ * length: the length of the text
+ *
+ * Return
+ * ------
+ * The number of numbers in the text.
+ */
+size_t text_count(const char* text, size_t length);
+
+/*
+ * This function parses the numbers of a text (one number per line) in
+ * an array of 64-bit words. A large text is split at the newlines, one
+ * chunk per worker; the integers are decoded eight digits at a time, and
+ * still checked for their bounds.
+ *
+ * Parameter(s)
+ * ------------
+ * text: the text
+ * length: the length of the text
+ * numbers: the array where to write the numbers (of size text_count)
+ * key: the type of the numbers
+ * workers: the number of workers (threads)
+ *
+ * Return
+ * ------
+ * 0 if all lines are valid numbers of this type, -1 otherwise.
+ */
+int text_parse(const char* text, size_t length, long* numbers, key_type key, int workers);
+
+/*
+ * This function returns the length of the text representation of an
+ * array (one number per line).
+ *
+ * Parameter(s)
+ * ------------
+ * numbers: the array
+ * size: the size of the array
+ * key: the type of the numbers
+ *
+ * Return
+ * ------
+ * The length of the text (in bytes).
+ */
+size_t text_length(const long* numbers, size_t size, key_type key);
+
+/*
+ * This function writes the text representation of an array (one number
+ * per line) in a buffer of size text_length.
+ *
+ * Parameter(s)
+ * ------------
+ * text: the buffer where to write
+ * numbers: the array
+ * size: the size of the array
+ * key: the type of the numbers
+ *
+ * Return
+ * ------
+ * The length of the text (in bytes).
+ */
+size_t text_format(char* text, const long* numbers, size_t size, key_type key);
+
+/*
+ * This function writes the text representation of an array in a file:
+ * each worker formats its part of the array in its own buffer, then the
+ * buffers are written in order.
+ *
+ * Parameter(s)
+ * ------------
+ * fd: the file descriptor where to write
+ * numbers: the array
+ * size: the size of the array
+ * key: the type of the numbers
+ * separator: the character written after each number (e.g. a newline)
+ * workers: the number of workers (threads)
+ *
+ * Return
+ * ------
+ * 0 if the text has been written, -1 otherwise (errno is set).
+ */
+int text_write(int fd, const long* numbers, size_t size, key_type key, char separator, int workers);
+
+/*
+ * This function copies the keys of a binary file (of key_size bytes each)
+ * in an array of 64-bit words.
+ *
+ * Parameter(s)
+ * ------------
+ * records: the keys of the binary file
+ * numbers: the array where to write the keys
+ * size: the number of keys
+ * key: the type of the keys
+ */
+void binary_widen(const void* records, long* numbers, size_t size, key_type key);
+
+/*
+ * This function copies an array of 64-bit words in the keys of a binary
+ * file (of key_size bytes each).
+ *
+ * Parameter(s)
+ * ------------
+ * records: the buffer where to write the keys
+ * numbers: the array
+ * size: the number of keys
+ * key: the type of the keys
+ */
+void binary_narrow(void* records, const long* numbers, size_t size, key_type key);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * File: key.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library defines the types of keys that can be sorted and their
+ * order-preserving transformations: each key, stored in a 64-bit word, is
+ * encoded in an unsigned integer such that the order of the encoded
+ * integers is the order of the keys (and decoded back afterwards).
+ *
+ * 32-bit keys (int32 and float) are stored one per 64-bit word: an int32
+ * is sign-extended, a float is stored in the low half of the word. In
+ * binary files, they are stored on 4 bytes.
+ */
+
+#ifndef _KEY_H_
+#define _KEY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    KEY_INT64,
+    KEY_UINT64,
+    KEY_INT32,
+    KEY_FLOAT,
+    KEY_DOUBLE
+} key_type;
+
+#define KEY_SIGN64 0x8000000000000000UL
+#define KEY_SIGN32 0x80000000UL
+#define KEY_MASK32 0xffffffffUL
+
+/*
+ * This function returns the size of a key in a binary file.
+ *
+ * Parameter(s)
+ * ------------
+ * key: the type of the key
+ *
+ * Return
+ * ------
+ * The size of the key (in bytes).
+ */
+static inline size_t key_size(key_type key) {
+    return key == KEY_INT32 || key == KEY_FLOAT ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+/*
+ * This function encodes a key in an unsigned integer with the same order
+ * (signed integers are shifted by flipping their sign bit, negative
+ * floating-point numbers have all their bits flipped and positive ones
+ * only their sign bit).
+ *
+ * Parameter(s)
+ * ------------
+ * word: the 64-bit word containing the key
+ * key: the type of the key
+ *
+ * Return
+ * ------
+ * The encoded key (on 32 bits for the 32-bit keys).
+ */
+static inline unsigned long key_encode(unsigned long word, key_type key) {
+    switch(key) {
+        case KEY_INT64:
+            return word ^ KEY_SIGN64;
+
+        case KEY_INT32:
+            return (word ^ KEY_SIGN32) & KEY_MASK32;
+
+        case KEY_FLOAT:
+            word &= KEY_MASK32;
+
+            return word & KEY_SIGN32 ? ~word & KEY_MASK32 : word | KEY_SIGN32;
+
+        case KEY_DOUBLE:
+            return word & KEY_SIGN64 ? ~word : word | KEY_SIGN64;
+
+        default:
+            return word;
+    }
+}
+
+/*
+ * This function decodes a key encoded by key_encode.
+ *
+ * Parameter(s)
+ * ------------
+ * code: the encoded key
+ * key: the type of the key
+ *
+ * Return
+ * ------
+ * The 64-bit word containing the key.
+ */
+static inline unsigned long key_decode(unsigned long code, key_type key) {
+    switch(key) {
+        case KEY_INT64:
+            return code ^ KEY_SIGN64;
+
+        case KEY_INT32:
+            return (unsigned long)(long)(int32_t)(uint32_t)(code ^ KEY_SIGN32);
+
+        case KEY_FLOAT:
+            return code & KEY_SIGN32 ? code & ~KEY_SIGN32 : ~code & KEY_MASK32;
+
+        case KEY_DOUBLE:
+            return code & KEY_SIGN64 ? code & ~KEY_SIGN64 : ~code;
+
+        default:
+            return code;
+    }
+}
+
+#endif
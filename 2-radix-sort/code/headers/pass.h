@@ -0,0 +1,81 @@
+/*
+ * File: pass.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the kernels of a pass of the LSD sort (the
+ * counting of the digits of a chunk and its scatter), specialised for
+ * each type of keys, width of digits and width of values: the encoding of
+ * the keys, the mask of the digits and the copy of the values are fixed
+ * at compilation, and the keys are handled several at a time. The
+ * kernels of a sort are chosen at runtime; the other sorts (records,
+ * arbitrary bases, other widths) keep the generic loops of the sort.
+ */
+
+#ifndef _PASS_H_
+#define _PASS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "key.h"
+
+/* Widths of the values with their own kernels (from 0 to PASS_PAYLOADS - 1 words) */
+#define PASS_PAYLOADS 3
+
+/* A pass over the keys: they are moved from src to dst at the offsets of their digits */
+typedef struct {
+    const long* src;
+    long* dst;
+    const long* vsrc; // values of the keys (structure of arrays), if any
+    long* vdst;
+    unsigned long min; // subtracted from the encoded keys
+    int shift;         // of the digit of the pass
+    bool first;        // the keys of src are not encoded yet
+    bool last;         // the keys are decoded in dst
+} pass_chunk;
+
+/* A kernel: counts (or scatters) the keys from *from* to *to* with the counts (offsets) of row */
+typedef void (*pass_kernel)(const pass_chunk* chunk, long from, long to, long* row);
+
+/* The kernels of a sort */
+typedef struct {
+    pass_kernel count;
+    pass_kernel scatter;
+} pass_kernels;
+
+/*
+ * This function chooses the kernels specialised for a sort.
+ *
+ * Parameter(s)
+ * ------------
+ * kernels: where to write the kernels
+ * key: the type of the keys
+ * bits: the bits of a digit (0 for an arbitrary base)
+ * record: the words of a record
+ * payload: the words of the values of a key
+ *
+ * Return
+ * ------
+ * 0 if the sort has its kernels, -1 otherwise (the generic loops are
+ * used).
+ */
+int pass_select(pass_kernels* kernels, key_type key, int bits, int record, int payload);
+
+/*
+ * This function checks every specialised kernel against the generic
+ * loops, on random keys.
+ *
+ * Parameter(s)
+ * ------------
+ * out: where to report the result
+ *
+ * Return
+ * ------
+ * 0 if all the kernels give the same counts and the same arrays as the
+ * generic loops, -1 otherwise.
+ */
+int pass_check(FILE* out);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * File: pool.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements a persistent pool of threads: the threads are
+ * created once and then run the jobs submitted to the pool, one at a
+ * time, all the threads of the pool working on the same job.
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+typedef struct {
+    int size;
+    pthread_t* threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    long generation; // number of jobs submitted so far
+    int running;     // threads still working on the current job
+    bool stop;
+
+    void (*job)(int, void*);
+    void* arg;
+} pool;
+
+/*
+ * This function creates a pool of threads. The calling thread is part of
+ * the pool (it gets the ID 0), so only *size - 1* threads are created.
+ *
+ * Parameter(s)
+ * ------------
+ * size: the number of threads of the pool
+ *
+ * Return
+ * ------
+ * A pointer to the pool.
+ */
+pool* pool_create(int size);
+
+/*
+ * This function runs a job on every thread of the pool and returns once
+ * they have all finished it.
+ *
+ * Parameter(s)
+ * ------------
+ * p: the pool
+ * job: the function run by each thread, with its ID (from 0 to size - 1)
+ *      and *arg*
+ * arg: the argument of the job
+ */
+void pool_run(pool* p, void (*job)(int, void*), void* arg);
+
+/*
+ * This function stops the threads of a pool and frees it.
+ *
+ * Parameter(s)
+ * ------------
+ * p: the pool to free
+ */
+void pool_free(pool* p);
+
+#endif
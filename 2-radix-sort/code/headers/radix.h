@@ -0,0 +1,470 @@
+/*
+ * File: radix.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the parallel radix sort: several workers that
+ * sort an array of numbers, one digit at a time, through shared
+ * memory and barriers. The workers are either processes forked for each
+ * sort, or the threads of a pool kept from one sort to the next.
+ *
+ * The workers first scan the keys together: an input already sorted (or
+ * sorted in reverse order) is only copied, the digits are those of the
+ * keys minus their minimum, and the passes whose digit is the same for
+ * all the keys are skipped.
+ *
+ * The digits are sorted either from the least significant one (LSD, every
+ * pass moves all the keys), or from the most significant one (MSD): after
+ * a first partition, the buckets are sorted recursively by the workers,
+ * which steal them from each other, down to small buckets sorted by
+ * insertion.
+ *
+ * On a host short of memory, the MSD sort can also permute the keys
+ * within their own buffer (American flag sort): each bucket is split by
+ * following cycles of swaps from the head of each sub-bucket, so that the
+ * only memory beyond the keys is a few counts per worker and digit. The
+ * first level is permuted by one worker, the buckets below it are shared
+ * as for the MSD sort. It is not stable, which only matters for keys that
+ * carry something (so it is only used for bare keys).
+ *
+ * When only the k smallest keys (or the key of a rank, such as a
+ * percentile) are needed, a selection follows the digits from the most
+ * significant one, keeping only the bucket of the rank at each level:
+ * the candidates are copied only once they are at most half of the keys
+ * read, so this costs about one pass instead of a full sort.
+ *
+ * The simplest use is radix_sort, which sorts an array in place. The keys
+ * can also carry values: in their own array (radix_sort_pairs, so that the
+ * keys stay dense while they are counted), in records that start with
+ * the key (radix_sort_records), or as indices (radix_argsort). The sorts
+ * are stable.
+ *
+ * A context (radix_create) keeps the scratch buffers and the threads from
+ * one sort to the next (with pinned workers, each of them touches its part
+ * of the buffers first, so that it is allocated on its NUMA node; the
+ * calling thread, the first worker of a pool, is pinned during a sort
+ * only); radix_run gives a finer control on where the numbers are read and
+ * written (e.g. memory mapped files).
+ *
+ * Compilation (as a static library)
+ * ---------------------------------
+ * gcc -c affinity.c array.c communication.c deque.c histogram.c pass.c pool.c
+ *     radix.c trace.c --pedantic -Wall -Wextra -Wmissing-prototypes -pthread
+ * ar rcs libradix.a affinity.o array.o communication.o deque.o histogram.o pass.o
+ *     pool.o radix.o trace.o
+ */
+
+#ifndef _RADIX_H_
+#define _RADIX_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "communication.h"
+#include "deque.h"
+#include "histogram.h"
+#include "key.h"
+#include "pool.h"
+#include "trace.h"
+
+/* Context of the sort: parameters, scratch buffers and workers */
+typedef struct {
+    // Parameters
+    size_t capacity; // maximal number of numbers to sort
+    int workers;
+    long base;
+    int bits;
+    bool huge;
+    bool threads;
+    key_type key;
+    int record;      // words of a record (the key is the first one)
+    int payload;     // words of the values of a key (in their own array)
+    bool msd;        // most significant digit first, by buckets
+    bool american;   // most significant digit first, in place (no scratch buffer of the keys)
+    bool affinity;   // workers pinned to a processor
+    bool combine;    // scatter through write-combining lines
+    bool trace;      // record the phases of the workers
+
+    // Scratch buffers (shared with the workers)
+    long* numbers;
+    long* temp;
+    long* values;
+    long* values_temp;
+    long* count;  // digit counts of each chunk of the keys
+    long* claims; // chunks taken by the workers of the current pass
+    long chunks;  // lines of the counts
+    long* total;
+    long* lines;  // write-combining lines (one per digit and worker)
+    long* starts;
+
+    // Kernel counting the digits (see histogram.h), and its tables (one set per worker)
+    histogram_kernel kernel;
+    const char* kernel_name;
+    long* ways;
+
+    barrier* pass_barrier;
+    pool* threads_pool;
+
+    // Pre-scan of the keys by the workers (see plan in radix.c)
+    long* scan;
+    long* plan;
+    long* digits; // histograms of all the digits, or NULL if too large
+    int passes;   // maximal number of digits of a key
+
+    // Placement of the workers (processor and node of each one)
+    int* cpus;
+    long* placement;
+
+    // Phases of each worker since the creation of the context (if recorded)
+    trace_log* traces;
+
+    // Buckets of the MSD sort (one deque per worker)
+    deque* deques;
+    task* tasks;
+    long deque_size;
+    long* pending; // buckets pushed but not sorted yet
+    long* flags;   // heads and tails of the sub-buckets of each worker (in-place MSD)
+
+    // Current sort
+    int active;
+    size_t N;
+    long* input;
+    long* output;
+    long* input_values;
+    long* output_values;
+    long* sorted_values; // where the values have been left by the sort
+    bool inplace;
+    long slices; // chunks of the current sort
+    bool top_down; // the current sort is an MSD one
+    bool flag;     // the current sort is an in-place MSD one
+    bool selecting; // the current run is a selection
+    size_t rank;    // rank to select
+    bool gather;    // gather the keys up to the rank
+    int executed;  // passes of the last sort over all the keys (0 if they were sorted)
+} radix_ctx;
+
+/* Options of the sort */
+typedef struct {
+    int bits;           // bits of a digit (the radix is 2^bits), 0 to use *base*
+    long base;          // arbitrary radix (only if bits is 0)
+    int workers;        // number of workers, 0 for the number of online processors
+    bool threads;       // threads of a pool rather than forked processes
+    bool huge;          // scratch buffers backed by huge pages
+    key_type key;       // type of the keys stored in the 64-bit words
+    int record;         // words of a record, the key being the first one (1 by default)
+    int payload;        // words of the values of a key, in their own array (0 by default)
+    bool msd;           // sort the buckets of the most significant digit recursively (keys only)
+    bool american;      // MSD sort in place, by cycles of swaps, without the scratch buffer of the keys (keys only)
+    bool affinity;      // pin each worker to a processor, and place its part of the buffers on its node
+    bool combine;       // stage the scattered keys by cache lines, flushed with streaming stores (bare keys only)
+    bool trace;         // record the phases of the workers (see radix_trace)
+    radix_ctx* scratch; // context to reuse (its own parameters are used), or NULL
+} radix_opts;
+
+/*
+ * This function sets the default options: signed 64-bit keys without
+ * values, LSD sort with digits of 8 bits, one thread per online
+ * processor, no huge pages and no context to reuse.
+ *
+ * Parameter(s)
+ * ------------
+ * opts: the options to initialize
+ */
+void radix_opts_init(radix_opts* opts);
+
+/*
+ * This function sorts an array of keys in place (their type is given by
+ * the options, see key.h for the storage of the 32-bit keys).
+ *
+ * Parameter(s)
+ * ------------
+ * keys: the numbers to sort
+ * n: the number of numbers to sort
+ * opts: the options of the sort, or NULL for the default ones
+ *
+ * Return
+ * ------
+ * 0 if the array has been sorted, -1 if the memory could not be allocated.
+ */
+int radix_sort(long* keys, size_t n, const radix_opts* opts);
+
+/*
+ * This function sorts an array of keys and an array of values (of
+ * *payload* words per key) in place, the values following their keys.
+ *
+ * Parameter(s)
+ * ------------
+ * keys: the keys to sort
+ * values: the values of the keys
+ * n: the number of keys
+ * payload: the number of words of the values of a key
+ * opts: the options of the sort, or NULL for the default ones (*record*
+ *       and *payload* are ignored)
+ *
+ * Return
+ * ------
+ * 0 if the arrays have been sorted, -1 if the memory could not be
+ * allocated.
+ */
+int radix_sort_pairs(long* keys, void* values, size_t n, int payload, const radix_opts* opts);
+
+/*
+ * This function sorts an array of records of *record* words in place, by
+ * the key in their first word.
+ *
+ * Parameter(s)
+ * ------------
+ * records: the records to sort
+ * n: the number of records
+ * record: the number of words of a record
+ * opts: the options of the sort, or NULL for the default ones (*record*
+ *       and *payload* are ignored)
+ *
+ * Return
+ * ------
+ * 0 if the array has been sorted, -1 if the memory could not be allocated.
+ */
+int radix_sort_records(void* records, size_t n, int record, const radix_opts* opts);
+
+/*
+ * This function computes the permutation that sorts an array of keys,
+ * without moving them: indices[i] is the position of the i-th smallest key.
+ *
+ * Parameter(s)
+ * ------------
+ * keys: the keys
+ * indices: the array where to write the permutation
+ * n: the number of keys
+ * opts: the options of the sort, or NULL for the default ones (*record*
+ *       and *payload* are ignored)
+ *
+ * Return
+ * ------
+ * 0 if the permutation has been computed, -1 if the memory could not be
+ * allocated.
+ */
+int radix_argsort(const long* keys, size_t* indices, size_t n, const radix_opts* opts);
+
+/*
+ * This function returns the key of a rank: the k-th smallest key (from 0),
+ * i.e. the one at position k once the keys are sorted.
+ *
+ * Parameter(s)
+ * ------------
+ * keys: the keys (left untouched)
+ * n: the number of keys
+ * k: the rank (less than n)
+ * key: where to write the key of the rank
+ * opts: the options of the sort, or NULL for the default ones (*record*
+ *       and *payload* are ignored)
+ *
+ * Return
+ * ------
+ * 0 if the key has been found, -1 if the memory could not be allocated.
+ */
+int radix_select(const long* keys, size_t n, size_t k, long* key, const radix_opts* opts);
+
+/*
+ * This function writes the k smallest keys, either in the order of the
+ * input (the ties of the largest one being its first occurrences) or
+ * sorted.
+ *
+ * Parameter(s)
+ * ------------
+ * keys: the keys (left untouched)
+ * n: the number of keys
+ * k: the number of keys to keep (at most n)
+ * top: where to write the k smallest keys
+ * sorted: true to sort them
+ * opts: the options of the sort, or NULL for the default ones (*record*
+ *       and *payload* are ignored)
+ *
+ * Return
+ * ------
+ * 0 if the keys have been written, -1 if the memory could not be
+ * allocated.
+ */
+int radix_top(const long* keys, size_t n, size_t k, long* top, bool sorted, const radix_opts* opts);
+
+/*
+ * This function checks the selection (radix_select and radix_top, sorted
+ * or in the order of the input) against a sort, on random keys with many
+ * ties and for several numbers of workers.
+ *
+ * Parameter(s)
+ * ------------
+ * out: where to report the result
+ *
+ * Return
+ * ------
+ * 0 if the selection gives the keys of the sort, -1 otherwise.
+ */
+int radix_check(FILE* out);
+
+/*
+ * This function creates a context: the scratch buffers, the barrier and
+ * the pool of threads (if any) used by the sort. It can then be used by
+ * several sorts of at most *capacity* numbers.
+ *
+ * Parameter(s)
+ * ------------
+ * capacity: the maximal number of numbers to sort
+ * opts: the options of the sort, or NULL for the default ones (*scratch*
+ *       is ignored)
+ *
+ * Return
+ * ------
+ * A pointer to the context, or NULL if the memory could not be allocated.
+ */
+radix_ctx* radix_create(size_t capacity, const radix_opts* opts);
+
+/*
+ * This function returns a scratch buffer of *capacity* records which can
+ * be filled with the numbers to sort and given as input to radix_run
+ * (this avoids a copy). An in-place context allocates it on the first
+ * call only, as it otherwise sorts the keys where they are.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ *
+ * Return
+ * ------
+ * A pointer to the buffer, or NULL if it could not be allocated.
+ */
+long* radix_buffer(radix_ctx* ctx);
+
+/*
+ * This function sorts an array of keys (of the type given when creating
+ * the context, or the last one given to radix_sort). The input is only
+ * read (unless it is also the output), it can thus be a read-only
+ * mapping of a file.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * input: the numbers to sort
+ * output: where to write the sorted numbers (shared with the workers if
+ *         they are processes), *input* to sort in place, or NULL to leave
+ *         them in a scratch buffer
+ * N: the number of numbers to sort (at most the capacity)
+ *
+ * Return
+ * ------
+ * A pointer to the sorted numbers (either *output* or a scratch buffer,
+ * valid until the next sort), or NULL if the scratch buffer of an in-place
+ * context could not be allocated (see radix_buffer).
+ */
+long* radix_run(radix_ctx* ctx, long* input, long* output, size_t N);
+
+/*
+ * This function sorts an array of keys and their values (for a context
+ * created with a payload), like radix_run.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * input: the keys to sort
+ * values: the values of the keys
+ * output: where to write the sorted keys, *input* to sort in place, or
+ *         NULL to leave them in a scratch buffer
+ * out_values: where to write the sorted values (*values* to sort in place,
+ *             NULL if and only if *output* is NULL)
+ * N: the number of keys to sort (at most the capacity)
+ *
+ * Return
+ * ------
+ * A pointer to the sorted keys, the sorted values being at
+ * ctx->sorted_values.
+ */
+long* radix_run_pairs(radix_ctx* ctx, long* input, long* values, long* output, long* out_values, size_t N);
+
+/*
+ * This function returns the key of a rank (for a context of bare keys,
+ * not in place), like radix_select.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * input: the keys (only read)
+ * N: the number of keys (at most the capacity)
+ * k: the rank (less than N)
+ *
+ * Return
+ * ------
+ * The key of the rank.
+ */
+long radix_run_select(radix_ctx* ctx, long* input, size_t N, size_t k);
+
+/*
+ * This function gathers the k smallest keys (for a context of bare keys,
+ * not in place), like radix_top.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * input: the keys (only read, it can be the buffer of radix_buffer)
+ * N: the number of keys (at most the capacity)
+ * k: the number of keys to keep (between 1 and N)
+ * sorted: true to sort them
+ *
+ * Return
+ * ------
+ * A pointer to the k smallest keys, in a scratch buffer (valid until the
+ * next sort).
+ */
+long* radix_run_top(radix_ctx* ctx, long* input, size_t N, size_t k, bool sorted);
+
+/*
+ * This function reports the placement of a context: the processor and
+ * the NUMA node of each worker (if they are pinned), and the number of
+ * pages of each scratch buffer on each node.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * out: where to write the report
+ */
+void radix_placement(radix_ctx* ctx, FILE* out);
+
+/*
+ * This function writes a summary of the phases recorded by the workers of
+ * a context (created with *trace*), over all its sorts: the time, keys,
+ * bytes, cache and TLB misses of each phase of each pass, and the time
+ * each worker spent waiting at the barriers.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * out: where to write the summary
+ */
+void radix_trace(radix_ctx* ctx, FILE* out);
+
+/*
+ * This function exports the phases recorded by the workers of a context
+ * as a Chrome trace (JSON trace events).
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context
+ * path: the path of the file
+ *
+ * Return
+ * ------
+ * 0 if the trace has been written, -1 if the phases have not been
+ * recorded or the file could not be written.
+ */
+int radix_trace_export(radix_ctx* ctx, const char* path);
+
+/*
+ * This function frees a context: it unmaps the scratch buffers and the
+ * barrier, and stops the threads.
+ *
+ * Parameter(s)
+ * ------------
+ * ctx: the context to free
+ */
+void radix_destroy(radix_ctx* ctx);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * File: service.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library is the client side of the sort daemon (see daemon.c): the
+ * keys are written by the client in a shared memory region (shm_open)
+ * that the daemon maps once, the sorts of the keys of the region are
+ * submitted through a Unix domain socket, and the daemon sorts them in
+ * place, then replies on the socket when each sort is done. The keys are
+ * never copied between the client and the daemon.
+ *
+ * A client can have many sorts in flight (in one or several regions): the
+ * replies come in the order in which the sorts are done, each one with
+ * the ID given by the client.
+ */
+
+#ifndef _SERVICE_H_
+#define _SERVICE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "key.h"
+
+/* Default path of the socket of the daemon */
+#define SERVICE_SOCKET "/tmp/radix.sock"
+
+/* Maximal length of the name of a region (with its '/') */
+#define SERVICE_NAME 64
+
+/* Types of the requests */
+#define SERVICE_MAP 0  // map a region in the daemon (the reply is its index)
+#define SERVICE_SORT 1 // sort keys of a mapped region (the reply is its status)
+
+/* ID of the mapping requests (reserved, never the ID of a sort) */
+#define SERVICE_MAP_ID LONG_MIN
+
+/* Status of a sort */
+#define SERVICE_DONE 0
+#define SERVICE_INVALID -1 // not keys of a region mapped by the client
+#define SERVICE_LARGE -2  // more keys than the capacity of the daemon
+#define SERVICE_MEMORY -3 // the region could not be mapped
+
+/* A request of a client */
+typedef struct {
+    int type;
+    int key;        // type of the keys (key_type)
+    long id;        // chosen by the client, given back in the reply
+    long region;    // index of the region (SERVICE_SORT)
+    size_t offset;  // first key to sort, in words from the start of the region
+    size_t n;       // number of keys to sort
+    size_t size;    // size of the region in bytes (SERVICE_MAP)
+    char name[SERVICE_NAME]; // name of the region (SERVICE_MAP)
+} service_request;
+
+/* The reply of the daemon */
+typedef struct {
+    long id;
+    long status; // index of the region, or status of the sort
+} service_reply;
+
+/* A region of keys shared with the daemon */
+typedef struct {
+    char name[SERVICE_NAME];
+    size_t size;
+    long* keys;
+    long index; // index of the region in the daemon
+} service_region;
+
+/*
+ * This function connects to the daemon.
+ *
+ * Parameter(s)
+ * ------------
+ * path: the path of the socket of the daemon
+ *
+ * Return
+ * ------
+ * The socket, or -1 if the daemon could not be reached.
+ */
+int service_connect(const char* path);
+
+/*
+ * This function creates a region of *capacity* keys and maps it in the
+ * client and in the daemon. No sort of the client may be in flight (all
+ * their replies received by service_wait): the reply of the mapping must
+ * be the next one. Otherwise, the reply read instead is lost, and the
+ * creation fails with errno set to EBUSY.
+ *
+ * Parameter(s)
+ * ------------
+ * fd: the socket of the client
+ * region: the region to create
+ * capacity: the number of keys of the region
+ *
+ * Return
+ * ------
+ * 0 if the region has been created, -1 otherwise.
+ */
+int service_region_create(int fd, service_region* region, size_t capacity);
+
+/*
+ * This function unmaps a region from the client and removes its name (the
+ * daemon unmaps it when the client disconnects).
+ *
+ * Parameter(s)
+ * ------------
+ * region: the region
+ */
+void service_region_free(service_region* region);
+
+/*
+ * This function submits the sort of keys of a region, without waiting
+ * for it.
+ *
+ * Parameter(s)
+ * ------------
+ * fd: the socket of the client
+ * region: the region of the keys
+ * offset: the index of the first key to sort
+ * n: the number of keys to sort
+ * key: the type of the keys
+ * id: the ID of the sort, given back by its reply (not SERVICE_MAP_ID)
+ *
+ * Return
+ * ------
+ * 0 if the sort has been submitted, -1 otherwise.
+ */
+int service_submit(int fd, const service_region* region, size_t offset, size_t n, key_type key, long id);
+
+/*
+ * This function waits for the next reply of the daemon to a sort (the
+ * late reply of a failed mapping is skipped).
+ *
+ * Parameter(s)
+ * ------------
+ * fd: the socket of the client
+ * reply: where to write the reply
+ *
+ * Return
+ * ------
+ * 0 if a reply has been received, -1 if the connection has been lost.
+ */
+int service_wait(int fd, service_reply* reply);
+
+#endif
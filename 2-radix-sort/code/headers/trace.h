@@ -0,0 +1,166 @@
+/*
+ * File: trace.h
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library records the phases of the workers of a sort: for each
+ * phase of each pass of each worker, its monotonic start and end times,
+ * the keys it processed and the bytes it moved, how it waited at the
+ * barriers, and the cache and TLB misses of the worker (hardware counters
+ * read with perf_event_open, when the kernel allows it).
+ *
+ * The events are written in logs shared with the workers (one per worker),
+ * then reported as a summary table or exported as a Chrome trace (JSON
+ * trace events, to open with chrome://tracing or Perfetto).
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+
+/* Maximal number of events in the log of a worker (the next ones are dropped) */
+#define TRACE_EVENTS 4096
+
+/* Hardware counters */
+#define TRACE_CACHE_MISSES 0
+#define TRACE_TLB_MISSES 1
+#define TRACE_COUNTERS 2
+
+/* Phases of a worker */
+typedef enum {
+    TRACE_PLAN,      // pre-scan of the keys (and copy of a sorted input)
+    TRACE_HISTOGRAM, // count of the digits of a slice
+    TRACE_OFFSETS,   // prefix sum of the counts
+    TRACE_SCATTER,   // move of the keys of a slice
+    TRACE_WAIT,      // wait at a barrier
+    TRACE_BUCKETS,   // recursive sort of the buckets (MSD)
+    TRACE_PHASES
+} trace_phase;
+
+/* An event: a phase of a pass of a worker */
+typedef struct {
+    int worker;
+    int pass;  // digit of the pass, -1 if the phase is not part of one
+    int phase;
+    int slept; // the worker slept at the barrier (TRACE_WAIT)
+    long start;
+    long end;  // monotonic times, in nanoseconds
+    long keys;
+    long bytes;
+    long counters[TRACE_COUNTERS]; // -1 if not available
+} trace_event;
+
+/* The log of a worker (in shared memory) */
+typedef struct {
+    long count;
+    long dropped;
+    trace_event events[TRACE_EVENTS];
+} trace_log;
+
+/* The state of a worker recording its phases (private to the worker) */
+typedef struct {
+    trace_log* log; // NULL if nothing is recorded
+    int worker;
+    int fds[TRACE_COUNTERS];
+    long start;
+    long counters[TRACE_COUNTERS];
+} tracer;
+
+/*
+ * This function prepares a worker to record its phases: it opens its
+ * hardware counters (if possible).
+ *
+ * Parameter(s)
+ * ------------
+ * t: the state of the worker
+ * log: the log of the worker, or NULL to record nothing
+ * worker: the ID of the worker
+ */
+void trace_open(tracer* t, trace_log* log, int worker);
+
+/*
+ * This function starts a phase.
+ *
+ * Parameter(s)
+ * ------------
+ * t: the state of the worker
+ */
+void trace_begin(tracer* t);
+
+/*
+ * This function ends the current phase and writes its event.
+ *
+ * Parameter(s)
+ * ------------
+ * t: the state of the worker
+ * phase: the phase
+ * pass: the digit of the pass, or -1
+ * keys: the number of keys processed
+ * bytes: the number of bytes moved
+ */
+void trace_end(tracer* t, trace_phase phase, int pass, long keys, long bytes);
+
+/*
+ * This function ends a wait at a barrier (started with trace_begin).
+ *
+ * Parameter(s)
+ * ------------
+ * t: the state of the worker
+ * pass: the digit of the pass, or -1
+ * how: how the worker waited (see barrier_wait)
+ */
+void trace_wait(tracer* t, int pass, int how);
+
+/*
+ * This function closes the hardware counters of a worker.
+ *
+ * Parameter(s)
+ * ------------
+ * t: the state of the worker
+ */
+void trace_close(tracer* t);
+
+/*
+ * This function empties the logs of the workers.
+ *
+ * Parameter(s)
+ * ------------
+ * logs: the logs
+ * workers: the number of workers
+ */
+void trace_reset(trace_log* logs, int workers);
+
+/*
+ * This function writes a summary of the logs: the time, keys, bytes and
+ * misses of each phase of each pass (over all the workers), then the busy
+ * and waiting times of each worker.
+ *
+ * Parameter(s)
+ * ------------
+ * logs: the logs
+ * workers: the number of workers
+ * out: where to write the summary
+ */
+void trace_summary(const trace_log* logs, int workers, FILE* out);
+
+/*
+ * This function exports the logs as a Chrome trace (a complete event per
+ * phase, one track per worker).
+ *
+ * Parameter(s)
+ * ------------
+ * logs: the logs
+ * workers: the number of workers
+ * path: the path of the JSON file
+ *
+ * Return
+ * ------
+ * 0 if the file has been written, -1 otherwise.
+ */
+int trace_export(const trace_log* logs, int workers, const char* path);
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * File: histogram.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the counting of the digits of an array of keys
+ * (the histogram of a pass), with a kernel chosen at runtime among the
+ * ones the processor supports (AVX-512, AVX2, SSE4.1 or scalar). The
+ * digits are extracted several keys at a time and counted in several
+ * tables (ways) in turn, so that repeated digits do not wait for each
+ * other's increment.
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "headers/histogram.h"
+
+/* Keys and widths of the digits of the self-check */
+#define CHECK_KEYS 100003
+#define CHECK_BITS 11
+
+/* ----- Prototypes ----- */
+static void scalar(const long* keys, size_t n, const histogram_digit* digit, long* ways);
+static void count(long* ways, size_t base, const unsigned long* digits);
+
+#if defined(__x86_64__)
+static void sse4(const long* keys, size_t n, const histogram_digit* digit, long* ways);
+static void avx2(const long* keys, size_t n, const histogram_digit* digit, long* ways);
+static void avx512(const long* keys, size_t n, const histogram_digit* digit, long* ways);
+#endif
+
+/* ----- Kernels, from the fastest to the slowest ----- */
+static const struct {
+    const char* name;
+    histogram_kernel kernel;
+} kernels[] = {
+#if defined(__x86_64__)
+    {"avx512", avx512},
+    {"avx2", avx2},
+    {"sse4.1", sse4},
+#endif
+    {"scalar", scalar}
+};
+
+#define KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/* ----- Support of a kernel by the processor ----- */
+static bool supported(histogram_kernel kernel) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+
+    if(kernel == avx512)
+        return __builtin_cpu_supports("avx512f");
+
+    if(kernel == avx2)
+        return __builtin_cpu_supports("avx2");
+
+    if(kernel == sse4)
+        return __builtin_cpu_supports("sse4.1");
+#endif
+
+    return kernel == scalar;
+}
+
+/* ----------------------------- */
+/* ---------- Kernels ---------- */
+/* ----------------------------- */
+static void scalar(const long* keys, size_t n, const histogram_digit* digit, long* ways) {
+    size_t i, base;
+
+    base = digit->mask + 1;
+
+    for(i = 0; i + HISTOGRAM_WAYS <= n; i += HISTOGRAM_WAYS) {
+        ways[HISTOGRAM_DIGIT(keys[i], digit)]++;
+        ways[base + HISTOGRAM_DIGIT(keys[i + 1], digit)]++;
+        ways[2 * base + HISTOGRAM_DIGIT(keys[i + 2], digit)]++;
+        ways[3 * base + HISTOGRAM_DIGIT(keys[i + 3], digit)]++;
+    }
+
+    for(; i < n; i++)
+        ways[HISTOGRAM_DIGIT(keys[i], digit)]++;
+}
+
+/* ----- Counting of 8 digits extracted at once, 2 in each table ----- */
+static inline void count(long* ways, size_t base, const unsigned long* digits) {
+    ways[digits[0]]++;
+    ways[base + digits[1]]++;
+    ways[2 * base + digits[2]]++;
+    ways[3 * base + digits[3]]++;
+    ways[digits[4]]++;
+    ways[base + digits[5]]++;
+    ways[2 * base + digits[6]]++;
+    ways[3 * base + digits[7]]++;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.1")))
+static void sse4(const long* keys, size_t n, const histogram_digit* digit, long* ways) {
+    unsigned long digits[8];
+    __m128i flip, min, mask, shift, v;
+    size_t i, j;
+
+    flip = _mm_set1_epi64x(digit->flip);
+    min = _mm_set1_epi64x(digit->min);
+    mask = _mm_set1_epi64x(digit->mask);
+    shift = _mm_cvtsi32_si128(digit->shift);
+
+    for(i = 0; i + 8 <= n; i += 8) {
+        for(j = 0; j < 8; j += 2) {
+            v = _mm_loadu_si128((const __m128i*)&keys[i + j]);
+            v = _mm_and_si128(_mm_srl_epi64(_mm_sub_epi64(_mm_xor_si128(v, flip), min), shift), mask);
+
+            digits[j] = _mm_cvtsi128_si64(v);
+            digits[j + 1] = _mm_extract_epi64(v, 1);
+        }
+
+        count(ways, digit->mask + 1, digits);
+    }
+
+    scalar(keys + i, n - i, digit, ways);
+}
+
+__attribute__((target("avx2")))
+static void avx2(const long* keys, size_t n, const histogram_digit* digit, long* ways) {
+    unsigned long digits[8];
+    __m256i flip, min, mask, v, w;
+    __m128i shift;
+    size_t i;
+
+    flip = _mm256_set1_epi64x(digit->flip);
+    min = _mm256_set1_epi64x(digit->min);
+    mask = _mm256_set1_epi64x(digit->mask);
+    shift = _mm_cvtsi32_si128(digit->shift);
+
+    for(i = 0; i + 8 <= n; i += 8) {
+        v = _mm256_loadu_si256((const __m256i*)&keys[i]);
+        w = _mm256_loadu_si256((const __m256i*)&keys[i + 4]);
+
+        v = _mm256_and_si256(_mm256_srl_epi64(_mm256_sub_epi64(_mm256_xor_si256(v, flip), min), shift), mask);
+        w = _mm256_and_si256(_mm256_srl_epi64(_mm256_sub_epi64(_mm256_xor_si256(w, flip), min), shift), mask);
+
+        _mm256_storeu_si256((__m256i*)&digits[0], v);
+        _mm256_storeu_si256((__m256i*)&digits[4], w);
+
+        count(ways, digit->mask + 1, digits);
+    }
+
+    scalar(keys + i, n - i, digit, ways);
+}
+
+__attribute__((target("avx512f")))
+static void avx512(const long* keys, size_t n, const histogram_digit* digit, long* ways) {
+    unsigned long digits[8];
+    __m512i flip, min, mask, v;
+    __m128i shift;
+    size_t i;
+
+    flip = _mm512_set1_epi64(digit->flip);
+    min = _mm512_set1_epi64(digit->min);
+    mask = _mm512_set1_epi64(digit->mask);
+    shift = _mm_cvtsi32_si128(digit->shift);
+
+    for(i = 0; i + 8 <= n; i += 8) {
+        v = _mm512_loadu_si512((const void*)&keys[i]);
+        v = _mm512_and_si512(_mm512_srl_epi64(_mm512_sub_epi64(_mm512_xor_si512(v, flip), min), shift), mask);
+
+        _mm512_storeu_si512((void*)digits, v);
+
+        count(ways, digit->mask + 1, digits);
+    }
+
+    scalar(keys + i, n - i, digit, ways);
+}
+#endif
+
+/* -------------------------------------- */
+/* ---------- Kernel selection ---------- */
+/* -------------------------------------- */
+histogram_kernel histogram_select(const char** name) {
+    size_t k;
+
+    // The scalar kernel, the last one, is always supported
+    for(k = 0; !supported(kernels[k].kernel); k++);
+
+    if(name != NULL)
+        *name = kernels[k].name;
+
+    return kernels[k].kernel;
+}
+
+void histogram_count(histogram_kernel kernel, const long* keys, size_t n, const histogram_digit* digit, long* ways, long* counts) {
+    assert(kernel != NULL);
+    assert(ways != NULL && counts != NULL);
+
+    size_t d, base;
+    int w;
+
+    base = digit->mask + 1;
+
+    memset(ways, 0, HISTOGRAM_WAYS * base * sizeof(long));
+
+    kernel(keys, n, digit, ways);
+
+    for(d = 0; d < base; d++)
+        for(w = 0; w < HISTOGRAM_WAYS; w++)
+            counts[d] += ways[w * base + d];
+}
+
+/* -------------------------------- */
+/* ---------- Self-check ---------- */
+/* -------------------------------- */
+int histogram_check(FILE* out) {
+    assert(out != NULL);
+
+    histogram_digit digit;
+    long* keys;
+    long* ways;
+    long* expected;
+    long* counts;
+    size_t i, k, n, base;
+    int bits, result;
+    bool same;
+
+    base = 1UL << CHECK_BITS;
+
+    keys = malloc(CHECK_KEYS * sizeof(long));
+    ways = malloc(HISTOGRAM_WAYS * base * sizeof(long));
+    expected = malloc(base * sizeof(long));
+    counts = malloc(base * sizeof(long));
+
+    if(keys == NULL || ways == NULL || expected == NULL || counts == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    // Random keys, with runs of repeated keys
+    srand(12);
+
+    for(i = 0; i < CHECK_KEYS; i++)
+        keys[i] = i % 7 == 0 && i > 0 ? keys[i - 1] : ((long)rand() << 33) ^ ((long)rand() << 11) ^ rand();
+
+    result = 0;
+
+    for(k = 0; k < KERNELS; k++) {
+        if(!supported(kernels[k].kernel)) {
+            fprintf(out, "Histogram kernel %s: not supported\n", kernels[k].name);
+
+            continue;
+        }
+
+        same = true;
+
+        // Every digit of the keys, for signed keys minus a minimum, and for a few lengths
+        for(bits = 1; bits <= CHECK_BITS; bits += 5) {
+            for(digit.shift = 0; digit.shift < 64; digit.shift += bits) {
+                digit.flip = 1UL << 63;
+                digit.min = digit.shift % 2 == 0 ? 0 : (unsigned long)keys[0] ^ digit.flip;
+                digit.mask = (1UL << bits) - 1;
+
+                for(n = CHECK_KEYS - 15; n <= CHECK_KEYS; n += 5) {
+                    memset(expected, 0, base * sizeof(long));
+                    memset(counts, 0, base * sizeof(long));
+
+                    histogram_count(scalar, keys, n, &digit, ways, expected);
+                    histogram_count(kernels[k].kernel, keys, n, &digit, ways, counts);
+
+                    if(memcmp(expected, counts, (digit.mask + 1) * sizeof(long)) != 0)
+                        same = false;
+                }
+            }
+        }
+
+        fprintf(out, "Histogram kernel %s: %s\n", kernels[k].name, same ? "ok" : "different from the scalar one");
+
+        if(!same)
+            result = -1;
+    }
+
+    free(keys);
+    free(ways);
+    free(expected);
+    free(counts);
+
+    return result;
+}
@@ -0,0 +1,623 @@
+/*
+ * File: io.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library allows the reading and the writing of arrays of numbers
+ * from and to files, through memory mappings (raw binary files of 64-bit
+ * words or text files with one number per line). The text of a number
+ * depends on the type of the keys (see key.h).
+ *
+ * Large texts are parsed and formatted by several workers: the text is
+ * split at the newlines into one chunk per worker (each one counts its
+ * lines, then parses them where its numbers go), and each worker formats
+ * its part of the numbers in its own buffer, the buffers being written in
+ * order with large writes.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "headers/io.h"
+#include "headers/pool.h"
+
+/* Text (in bytes) or numbers below which a single worker parses or formats them */
+#define TEXT_PARALLEL (1 << 20)
+
+/* ----- Structure declaration ----- */
+// A text parsed or formatted by several workers
+typedef struct {
+    const char* text;
+    size_t length;
+    long* numbers;
+    const long* keys;
+    size_t size;
+    key_type key;
+    char separator;
+    int workers;
+
+    size_t* bounds; // chunk of the text of each worker (and the end of the last one)
+    size_t* counts; // numbers of each worker, then the first one of each worker
+    int* status;    // result of each worker
+    char** buffers; // formatted text of each worker
+} text_job;
+
+/* ----- Prototypes ----- */
+static inline bool eight_digits(unsigned long block);
+static inline unsigned long eight_value(unsigned long block);
+static int float_parse(const char* text, size_t length, size_t* i, unsigned long* word, key_type key);
+static int chunk_parse(const char* text, size_t length, long* numbers, key_type key);
+static size_t number_format(char* text, long word, key_type key);
+static size_t number_width(key_type key);
+static void run_job(text_job* job, void (*run)(int, void*));
+static void count_job(int id, void* arg);
+static void parse_job(int id, void* arg);
+static void format_job(int id, void* arg);
+static int write_all(int fd, const char* data, size_t length);
+
+/* --------------------------- */
+/* ---------- Files ---------- */
+/* --------------------------- */
+void* file_map(const char* path, size_t* length) {
+    assert(path != NULL);
+    assert(length != NULL);
+
+    struct stat st;
+    void* map;
+    int fd;
+
+    if((fd = open(path, O_RDONLY)) == -1) {
+        perror("open");
+
+        exit(errno);
+    }
+
+    if(fstat(fd, &st) == -1) {
+        perror("fstat");
+
+        exit(errno);
+    }
+
+    *length = (size_t)st.st_size;
+    map = NULL;
+
+    if(*length > 0) {
+        map = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(map == MAP_FAILED) {
+            perror("mmap");
+
+            exit(errno);
+        }
+
+        // The file is read from the beginning to the end by the first pass
+        madvise(map, *length, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+
+    return map;
+}
+
+void* file_create(const char* path, size_t length) {
+    assert(path != NULL);
+    assert(length > 0);
+
+    void* map;
+    int fd;
+
+    if((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) == -1) {
+        perror("open");
+
+        exit(errno);
+    }
+
+    if(ftruncate(fd, length) == -1) {
+        perror("ftruncate");
+
+        exit(errno);
+    }
+
+    map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if(map == MAP_FAILED) {
+        perror("mmap");
+
+        exit(errno);
+    }
+
+    close(fd);
+
+    return map;
+}
+
+int file_open(const char* path) {
+    assert(path != NULL);
+
+    int fd;
+
+    if((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1) {
+        perror("open");
+
+        exit(errno);
+    }
+
+    return fd;
+}
+
+void file_unmap(void* map, size_t length) {
+    if(map == NULL || length == 0)
+        return;
+
+    if(munmap(map, length) == -1) {
+        perror("munmap");
+
+        exit(errno);
+    }
+}
+
+/* -------------------------- */
+/* ---------- Text ---------- */
+/* -------------------------- */
+size_t text_count(const char* text, size_t length) {
+    const char* end;
+    const char* line;
+    size_t count;
+
+    count = 0;
+    end = text + length;
+
+    // memchr skips the digits by whole vectors
+    for(line = text; line < end && (line = memchr(line, '\n', end - line)) != NULL; line++)
+        count++;
+
+    // The last line may not end with a newline
+    if(length > 0 && text[length - 1] != '\n')
+        count++;
+
+    return count;
+}
+
+/* ----- Eight digits at once, in a little-endian word ----- */
+static inline bool eight_digits(unsigned long block) {
+    // Each byte is between 0x30 and 0x3f, and still is plus 6
+    return ((block & 0xf0f0f0f0f0f0f0f0UL) | (((block + 0x0606060606060606UL) & 0xf0f0f0f0f0f0f0f0UL) >> 4)) == 0x3333333333333333UL;
+}
+
+static inline unsigned long eight_value(unsigned long block) {
+    // Pairs of digits, then pairs of pairs, then the two halves
+    block -= 0x3030303030303030UL;
+    block = block * 10 + (block >> 8);
+
+    return (((block & 0x000000ff000000ffUL) * (100 + (1000000UL << 32))) + (((block >> 16) & 0x000000ff000000ffUL) * (1 + (10000UL << 32)))) >> 32;
+}
+
+/* ----- Parsing of a floating-point number (up to the end of the line) ----- */
+static int float_parse(const char* text, size_t length, size_t* i, unsigned long* word, key_type key) {
+    char token[TEXT_TOKEN];
+    char* endp;
+    size_t n;
+    double value;
+    float single;
+    uint32_t bits;
+
+    // strtod needs a null-terminated string
+    for(n = 0; *i + n < length && text[*i + n] != '\n' && text[*i + n] != '\r'; n++)
+        if(n + 1 == TEXT_TOKEN)
+            return -1; // too long
+
+    memcpy(token, text + *i, n);
+    token[n] = '\0';
+    *i += n;
+
+    value = 0;
+    single = 0;
+    errno = 0;
+
+    if(key == KEY_FLOAT) {
+        single = strtof(token, &endp);
+
+        memcpy(&bits, &single, sizeof(bits));
+        *word = bits;
+    } else {
+        value = strtod(token, &endp);
+
+        memcpy(word, &value, sizeof(*word));
+    }
+
+    // Underflows are rounded, overflows are rejected
+    if(n == 0 || *endp != '\0' || (errno == ERANGE && (key == KEY_FLOAT ? isinf(single) : isinf(value))))
+        return -1;
+
+    return 0;
+}
+
+/* ----- Parsing of the lines of a chunk ----- */
+static int chunk_parse(const char* text, size_t length, long* numbers, key_type key) {
+    unsigned long value, limit, block;
+    size_t i, n;
+    bool negative;
+    int digits;
+
+    i = 0;
+    n = 0;
+
+    while(i < length) {
+        if(key == KEY_FLOAT || key == KEY_DOUBLE) {
+            if(float_parse(text, length, &i, &value, key) == -1)
+                return -1;
+
+            digits = 1;
+            negative = false;
+        } else {
+            negative = text[i] == '-';
+
+            if(negative || text[i] == '+')
+                i++;
+
+            // The bound of the magnitude depends on the type of the keys
+            if(key == KEY_UINT64)
+                limit = negative ? 0 : ULONG_MAX;
+            else if(key == KEY_INT32)
+                limit = negative ? (unsigned long)INT32_MAX + 1 : (unsigned long)INT32_MAX;
+            else
+                limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+
+            value = 0;
+            digits = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            // The first sixteen digits by blocks of eight (less than 10^16, no overflow)
+            for(; digits < 16 && i + sizeof(block) <= length; i += sizeof(block), digits += sizeof(block)) {
+                memcpy(&block, text + i, sizeof(block));
+
+                if(!eight_digits(block))
+                    break;
+
+                value = value * 100000000 + eight_value(block);
+            }
+
+            if(value > limit)
+                return -1; // too large
+#endif
+
+            for(; i < length && text[i] >= '0' && text[i] <= '9'; i++, digits++) {
+                // (a digit larger than the bound, e.g. of a negative uint64, is too large too)
+                if((unsigned long)(text[i] - '0') > limit || value > (limit - (text[i] - '0')) / 10)
+                    return -1; // too large
+
+                value = value * 10 + (text[i] - '0');
+            }
+        }
+
+        // Allow Windows line endings
+        if(i < length && text[i] == '\r')
+            i++;
+
+        if(digits == 0 || (i < length && text[i] != '\n'))
+            return -1;
+
+        numbers[n++] = negative ? (long)(0 - value) : (long)value;
+        i++;
+    }
+
+    return 0;
+}
+
+int text_parse(const char* text, size_t length, long* numbers, key_type key, int workers) {
+    assert(numbers != NULL || length == 0);
+    assert(workers > 0);
+
+    text_job job;
+    size_t total, count;
+    int w, status;
+
+    if(length < TEXT_PARALLEL || workers == 1)
+        return chunk_parse(text, length, numbers, key);
+
+    job.text = text;
+    job.length = length;
+    job.numbers = numbers;
+    job.key = key;
+    job.workers = workers;
+    job.bounds = malloc((workers + 1) * sizeof(size_t));
+    job.counts = malloc(workers * sizeof(size_t));
+    job.status = malloc(workers * sizeof(int));
+
+    if(job.bounds == NULL || job.counts == NULL || job.status == NULL) {
+        free(job.bounds);
+        free(job.counts);
+        free(job.status);
+
+        return chunk_parse(text, length, numbers, key);
+    }
+
+    /* ----- Chunks of the workers (each one ends at a newline) ----- */
+    job.bounds[0] = 0;
+    job.bounds[workers] = length;
+
+    for(w = 1; w < workers; w++) {
+        job.bounds[w] = length * w / workers;
+
+        if(job.bounds[w] < job.bounds[w - 1])
+            job.bounds[w] = job.bounds[w - 1];
+
+        while(job.bounds[w] < length && text[job.bounds[w] - 1] != '\n')
+            job.bounds[w]++;
+    }
+
+    /* ----- Lines of each chunk, then where their numbers go ----- */
+    run_job(&job, count_job);
+
+    for(total = 0, w = 0; w < workers; w++) {
+        count = job.counts[w];
+        job.counts[w] = total;
+        total += count;
+    }
+
+    run_job(&job, parse_job);
+
+    for(status = 0, w = 0; w < workers; w++)
+        status = job.status[w] == -1 ? -1 : status;
+
+    free(job.bounds);
+    free(job.counts);
+    free(job.status);
+
+    return status;
+}
+
+/* ----- Text of a number (without the newline) ----- */
+static size_t number_format(char* text, long word, key_type key) {
+    char digits[24];
+    unsigned long value;
+    uint32_t bits;
+    float single;
+    double real;
+    size_t length;
+    bool negative;
+    int d;
+
+    switch(key) {
+        case KEY_FLOAT:
+            bits = (uint32_t)word;
+            memcpy(&single, &bits, sizeof(single));
+
+            return sprintf(text, "%.9g", single);
+
+        case KEY_DOUBLE:
+            memcpy(&real, &word, sizeof(real));
+
+            return sprintf(text, "%.17g", real);
+
+        default:
+            break;
+    }
+
+    negative = key != KEY_UINT64 && word < 0;
+    value = negative ? 0 - (unsigned long)word : (unsigned long)word;
+    length = 0;
+    d = 0;
+
+    do {
+        digits[d++] = '0' + value % 10;
+        value /= 10;
+    } while(value > 0);
+
+    if(negative)
+        text[length++] = '-';
+
+    while(d > 0)
+        text[length++] = digits[--d];
+
+    return length;
+}
+
+size_t text_length(const long* numbers, size_t size, key_type key) {
+    assert(numbers != NULL || size == 0);
+
+    char text[TEXT_TOKEN];
+    size_t i, length;
+
+    length = 0;
+
+    for(i = 0; i < size; i++)
+        length += number_format(text, numbers[i], key) + 1; // and newline
+
+    return length;
+}
+
+size_t text_format(char* text, const long* numbers, size_t size, key_type key) {
+    assert(text != NULL || size == 0);
+
+    size_t i, length;
+
+    for(length = 0, i = 0; i < size; i++) {
+        length += number_format(text + length, numbers[i], key);
+
+        text[length++] = '\n';
+    }
+
+    return length;
+}
+
+/* ----- Longest text of a number ----- */
+static size_t number_width(key_type key) {
+    switch(key) {
+        case KEY_FLOAT:
+            return 15; // -1.17549435e-38
+
+        case KEY_DOUBLE:
+            return 24; // -2.2250738585072014e-308
+
+        default:
+            return 20; // -9223372036854775808
+    }
+}
+
+int text_write(int fd, const long* numbers, size_t size, key_type key, char separator, int workers) {
+    assert(numbers != NULL || size == 0);
+    assert(workers > 0);
+
+    text_job job;
+    int w, status;
+
+    if(size < TEXT_PARALLEL / number_width(key))
+        workers = 1;
+
+    job.keys = numbers;
+    job.size = size;
+    job.key = key;
+    job.separator = separator;
+    job.workers = workers;
+    job.counts = malloc(workers * sizeof(size_t));
+    job.buffers = malloc(workers * sizeof(char*));
+
+    if(job.counts == NULL || job.buffers == NULL) {
+        free(job.counts);
+        free(job.buffers);
+
+        errno = ENOMEM;
+
+        return -1;
+    }
+
+    /* ----- Text of each part of the numbers, then written in order ----- */
+    run_job(&job, format_job);
+
+    status = 0;
+
+    for(w = 0; w < workers; w++) {
+        if(job.buffers[w] == NULL) {
+            errno = ENOMEM;
+            status = -1;
+        } else if(status == 0) {
+            status = write_all(fd, job.buffers[w], job.counts[w]);
+        }
+
+        free(job.buffers[w]);
+    }
+
+    free(job.counts);
+    free(job.buffers);
+
+    return status;
+}
+
+/* ----------------------------- */
+/* ---------- Workers ---------- */
+/* ----------------------------- */
+static void run_job(text_job* job, void (*run)(int, void*)) {
+    pool* p;
+    int w;
+
+    // Without threads, the workers run one after the other
+    if(job->workers > 1 && (p = pool_create(job->workers)) != NULL) {
+        pool_run(p, run, job);
+        pool_free(p);
+
+        return;
+    }
+
+    for(w = 0; w < job->workers; w++)
+        run(w, job);
+}
+
+static void count_job(int id, void* arg) {
+    text_job* job = arg;
+
+    job->counts[id] = text_count(job->text + job->bounds[id], job->bounds[id + 1] - job->bounds[id]);
+}
+
+static void parse_job(int id, void* arg) {
+    text_job* job = arg;
+
+    job->status[id] = chunk_parse(job->text + job->bounds[id], job->bounds[id + 1] - job->bounds[id], job->numbers + job->counts[id], job->key);
+}
+
+static void format_job(int id, void* arg) {
+    text_job* job = arg;
+    size_t i, begin, end, length;
+    char* text;
+
+    begin = job->size * id / job->workers;
+    end = job->size * (id + 1) / job->workers;
+
+    // The longest number, its separator and the null character of sprintf
+    job->counts[id] = 0;
+    job->buffers[id] = text = malloc((end - begin) * (number_width(job->key) + 1) + TEXT_TOKEN);
+
+    if(text == NULL)
+        return;
+
+    for(length = 0, i = begin; i < end; i++) {
+        length += number_format(text + length, job->keys[i], job->key);
+
+        text[length++] = job->separator;
+    }
+
+    job->counts[id] = length;
+}
+
+static int write_all(int fd, const char* data, size_t length) {
+    ssize_t written;
+
+    while(length > 0) {
+        if((written = write(fd, data, length)) == -1) {
+            if(errno == EINTR)
+                continue;
+
+            return -1;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+/* ---------------------------- */
+/* ---------- Binary ---------- */
+/* ---------------------------- */
+void binary_widen(const void* records, long* numbers, size_t size, key_type key) {
+    assert(records != NULL || size == 0);
+
+    const uint32_t* words;
+    size_t i;
+
+    if(key_size(key) == sizeof(long)) {
+        memcpy(numbers, records, size * sizeof(long));
+
+        return;
+    }
+
+    words = records;
+
+    // An int32 is sign-extended, the bits of a float are kept as they are
+    for(i = 0; i < size; i++)
+        numbers[i] = key == KEY_INT32 ? (long)(int32_t)words[i] : (long)words[i];
+}
+
+void binary_narrow(void* records, const long* numbers, size_t size, key_type key) {
+    assert(records != NULL || size == 0);
+
+    uint32_t* words;
+    size_t i;
+
+    if(key_size(key) == sizeof(long)) {
+        memcpy(records, numbers, size * sizeof(long));
+
+        return;
+    }
+
+    words = records;
+
+    for(i = 0; i < size; i++)
+        words[i] = (uint32_t)numbers[i];
+}
@@ -4,406 +4,651 @@
  *
  * The main file of the project.
  *
+ * Compilation
+ * -----------
+ * gcc main.c array.c communication.c io.c radix.c external.c pool.c deque.c
+ *     affinity.c histogram.c pass.c trace.c --pedantic -Wall -Wextra
+ *     -Wmissing-prototypes -pthread -o main
+ *
  * Usage
  * -----
- * ./main (base) (size) (array)
- * example: ./main 10 5 4 54 21 32 3
+ * ./main [options] (size) (array)
+ * ./main [options] -i input [-o output]
+ * example: ./main -j 4 -b 8 5 4 54 21 32 3
+ * example: ./main -f binary -i numbers.bin -o sorted.bin
+ * example: ./main -k double 4 3.5 -1e3 0 -0.25
+ * example: ./main -R 50% -f binary -i numbers.bin
+ *
+ * Option(s)
+ * ---------
+ * -j, --workers: the number of workers (default: the number of online
+ *                processors)
+ * -t, --threads: the workers are threads of a single process rather than
+ *                forked processes
+ * -b, --bits: the radix is 2^bits, digits are extracted with a shift and
+ *             a mask (default: 8 bits)
+ * -B, --base: an arbitrary radix, digits are extracted with a division
+ *             and a modulo (slower fallback)
+ * -M, --msd: sort from the most significant digit, bucket by bucket,
+ *            small buckets being sorted by insertion
+ * -I, --in-place: sort from the most significant digit by swapping the
+ *                 keys within their buffer (American flag sort), without
+ *                 a scratch buffer of the keys (ignored by -R and -K)
+ * -W, --write-combining: scatter the keys through a cache line per digit,
+ *                        written at once with streaming stores
+ * -i, --input: the file containing the numbers to sort (instead of the
+ *              command line)
+ * -o, --output: the file where to write the sorted numbers (instead of
+ *               the console)
+ * -f, --format: the format of the files, "text" (one number per line,
+ *               default) or "binary" (raw keys, 4 bytes for int32 and
+ *               float, 8 bytes otherwise)
+ * -k, --key: the type of the keys, "int64" (default), "uint64", "int32",
+ *            "float" or "double"
+ * -m, --memory: the memory budget (e.g. 512M, 32G); larger input files
+ *               are sorted by runs spilled to temporary files and merged
+ * -T, --tmpdir: the directory of the temporary files (default: $TMPDIR
+ *               or /tmp)
+ * -H, --huge-pages: back the scratch buffers with huge pages (reserved
+ *                   ones if any, transparent ones otherwise)
+ * -A, --affinity: pin each worker to a processor and allocate its part of
+ *                 the buffers on its NUMA node (the placement is reported
+ *                 on the standard error)
+ * -R, --rank: only print the key of a rank, either a position in the sorted
+ *             keys (from 0) or a percentile (e.g. 99.9%)
+ * -K, --top: only keep the K smallest keys (sorted, unless -U is given)
+ * -U, --unordered: keep the K smallest keys in the order of the input
+ * -P, --profile: record the phases of the workers, write their summary on
+ *                the standard error and their Chrome trace in the given
+ *                file (in memory sorts only, an error with the external sort)
+ * -S, --self-check: check the vectorised histogram kernels supported by the
+ *                   processor against the scalar one, the specialised
+ *                   pass kernels against the generic loops, and the
+ *                   selection against a sort, then exit
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <math.h>
 #include <unistd.h>
+#include <getopt.h>
 
-#include "headers/array.h"
-#include "headers/communication.h"
+#include "headers/radix.h"
+#include "headers/external.h"
+#include "headers/io.h"
+#include "headers/pass.h"
 
-/* ----- Union declaration ----- */
-union semun {
-    int val;
-    struct semid_ds *buf;
-    unsigned short int *array;
-    struct seminfo *__buf;
-};
+/* ----- Prototypes ----- */
+static size_t parse_size(const char* str);
+static int parse_key(const char* str, key_type* key);
+static int parse_rank(const char* str, long N, long* rank);
 
-/* ----- Shared variables ----- */
-long* shm_numbers;
-long* shm_temp;
-long* shm_sorted;
+/* ----- Parsing of a memory size (with an optional K, M or G suffix) ----- */
+static size_t parse_size(const char* str) {
+    char* endp;
+    long size;
 
-int sem_worker, sem_master;
+    errno = 0;
+    size = strtol(str, &endp, 10);
 
-int msgq_1, msgq_2;
+    if(errno != 0 || size <= 0)
+        return 0;
 
-/* ----- Prototypes ----- */
-void worker(int id, long N, long base);
-void master(long base, int iter, long N);
+    switch(*endp) {
+        case 'G': case 'g':
+            size *= 1024;
+            /* fall through */
+        case 'M': case 'm':
+            size *= 1024;
+            /* fall through */
+        case 'K': case 'k':
+            size *= 1024;
+            endp++;
+            break;
+    }
 
-/* ----- Worker process ----- */
-void worker(int id, long N, long base) {
-    /* ----- Variable declaration ----- */
-    // Message queue communication
-    message msg;
-    long write_pos;
+    if(strlen(endp) > 0)
+        return 0;
 
-    // Variable useful for execution
-    long i, value, num, digit, divisor, nb, pos, begin, end;
-    bool search;
+    return (size_t)size;
+}
 
-    /* ----- Get worker informations ----- */
-    search = true;
+/* ----- Parsing of a rank (a position, or a percentile of N keys) ----- */
+static int parse_rank(const char* str, long N, long* rank) {
+    char* endp;
+    double percent;
 
-    // Where we must read in array.
-    begin = floor(N / base) * id;
-    end = floor(N / base) * (id + 1) - 1;
+    errno = 0;
 
-    divisor = 1;
+    if(str[strlen(str) - 1] == '%') {
+        percent = strtod(str, &endp);
 
-    // Last worker
-    if(id == base - 1)
-        end = N - 1;
+        if(errno != 0 || *endp != '%' || endp[1] != '\0' || percent < 0 || percent > 100)
+            return -1;
 
-    if(N < base) {
-        if(id >= N) // We are idle in the first step of execution.
-            search = false;
+        *rank = (long)(percent / 100 * (N - 1) + 0.5);
 
-        begin = id; // We have only one element to retrieve.
-        end = id;
+        return 0;
     }
 
-    /* ----- Manipulation of the array ----- */
-    while(shm_read(shm_sorted, 0) == 0) {
-        if(search) {
-            // Writing in the temporary array
-            pos = begin; // to know where to write in temporary array, so it is not corrupted
+    *rank = strtol(str, &endp, 10);
 
-            for(i = begin; i <= end; i++) {
-                num = shm_read(shm_numbers, i);
-                digit = (num / divisor) % base;
+    if(errno != 0 || strlen(endp) > 0 || *rank < 0 || *rank >= N)
+        return -1;
 
-                shm_write(shm_temp, get_index(N, digit, pos), num);
-                pos++;
-            }
+    return 0;
+}
+
+/* ----- Parsing of a type of keys ----- */
+static int parse_key(const char* str, key_type* key) {
+    static const char* names[] = {"int64", "uint64", "int32", "float", "double"};
+    static const key_type types[] = {KEY_INT64, KEY_UINT64, KEY_INT32, KEY_FLOAT, KEY_DOUBLE};
+    size_t i;
+
+    for(i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if(strcmp(str, names[i]) == 0) {
+            *key = types[i];
+
+            return 0;
         }
+    }
 
-        divisor *= base;
+    return -1;
+}
 
-        // Semaphores management
-        sem_unlock(sem_worker, 0);
-        sem_lock(sem_master, 0);
+/* ----- Main process ----- */
+int main(int argc, char* argv[]) {
+    /* --------------------------------------- */
+    /* ---------- Preparation phase ---------- */
+    /* --------------------------------------- */
 
-        // Number of elements on the worker's line
-        nb = 0;
+    /* ----- Variable declaration ----- */
+    // User parameters
+    long N, base;
+    int bits, workers;
+    char* endp;
 
-        for(i = 0; i < N; i++)
-            if(shm_read(shm_temp, get_index(N, id, i)) != -1)
-                nb++;
+    // Command line options
+    int opt;
+    bool binary, huge, threads, msd, american, affinity, combine, unordered, valid;
+    char* input;
+    char* rank_str;
+    char* profile;
+    char* output;
+    char* tmpdir;
+    size_t memory;
+    key_type key;
+    long top, rank;
+
+    static const struct option options[] = {
+        {"workers", required_argument, NULL, 'j'},
+        {"threads", no_argument, NULL, 't'},
+        {"bits", required_argument, NULL, 'b'},
+        {"base", required_argument, NULL, 'B'},
+        {"msd", no_argument, NULL, 'M'},
+        {"in-place", no_argument, NULL, 'I'},
+        {"write-combining", no_argument, NULL, 'W'},
+        {"input", required_argument, NULL, 'i'},
+        {"output", required_argument, NULL, 'o'},
+        {"format", required_argument, NULL, 'f'},
+        {"memory", required_argument, NULL, 'm'},
+        {"tmpdir", required_argument, NULL, 'T'},
+        {"huge-pages", no_argument, NULL, 'H'},
+        {"affinity", no_argument, NULL, 'A'},
+        {"key", required_argument, NULL, 'k'},
+        {"rank", required_argument, NULL, 'R'},
+        {"top", required_argument, NULL, 'K'},
+        {"unordered", no_argument, NULL, 'U'},
+        {"profile", required_argument, NULL, 'P'},
+        {"self-check", no_argument, NULL, 'S'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // File mappings
+    char* in_map;
+    char* out_map;
+    size_t in_length, out_length;
+    int out_fd;
+    long* map_input;
+    long* map_output;
+
+    // Sort
+    radix_opts opts;
+    radix_ctx* ctx;
 
-        // Message queue communication
-        msg.mtype = (long)(id + 1);
-        msg.digit = (long)id;
-        msg.num_numbers = nb;
-        msg.write_pos = (long)0;
+    // Variable useful for execution
+    long i, selected;
+    long* sorted;
+    char number[TEXT_TOKEN];
 
-        msgq_send(msgq_1, &msg);
-        msgq_read(msgq_2, (long)(id + 1), &msg); // Where to start writing back
+    /* ----- Verification and get the user parameters ----- */
+    // Retrieving the options ('+' stops at the first positional argument)
+    workers = 0;
+    bits = 8;
+    base = 0;
 
-        write_pos = msg.write_pos;
+    binary = false;
+    huge = false;
+    threads = false;
+    msd = false;
+    american = false;
+    affinity = false;
+    combine = false;
+    input = NULL;
+    output = NULL;
+    profile = NULL;
+    rank_str = NULL;
+    top = 0;
+    rank = 0;
+    unordered = false;
+    memory = 0;
+    key = KEY_INT64;
 
-        // Writing in the main array
-        for(i = 0; i < N; i++) {
-            value = shm_read(shm_temp, get_index(N, id, i));
+    tmpdir = getenv("TMPDIR");
 
-            if(value != -1) {
-                shm_write(shm_numbers, write_pos, value);
-                write_pos++;
-            }
-        }
+    if(tmpdir == NULL)
+        tmpdir = "/tmp";
 
-        // Semaphores management
-        sem_unlock(sem_worker, 0);
-        sem_lock(sem_master, 1);
-    }
+    while((opt = getopt_long(argc, argv, "+j:tb:B:MIWi:o:f:m:T:HAk:R:K:UP:S", options, NULL)) != -1) {
+        switch(opt) {
+            case 'j':
+                errno = 0;
+                workers = strtol(optarg, &endp, 10);
 
-    sem_unlock(sem_worker, 0);
-}
+                if(errno != 0 || strlen(endp) > 0 || workers <= 0) {
+                    printf("The number of workers should be a strictly positive number.\n");
 
-/* ----- Master process ----- */
-void master(long base, int iter, long N) {
-    /* ----- Variable declaration ----- */
-    // Message queue communication
-    message* msg;
+                    return EXIT_FAILURE;
+                }
 
-    // Variable useful for execution
-    long i, j, to_write;
+                break;
 
-    /* ----- Process ----- */
-    for(i = 0; i < iter; i++) {
-        // We wait for all workers to put everything in the temporary array
-        for(j = 0; j < base; j++)
-            sem_lock(sem_worker, 0);
+            case 't':
+                threads = true;
 
-        // We signal them they can proceed to the next phase
-        for(j = 0; j < base; j++)
-            sem_unlock(sem_master, 0);
+                break;
 
-        msg = (message*)malloc(base * sizeof(message));
+            case 'b':
+                errno = 0;
+                bits = strtol(optarg, &endp, 10);
 
-        if(msg == NULL) {
-            printf("Error with malloc.\n");
+                if(errno != 0 || strlen(endp) > 0 || bits <= 0 || bits > 24) {
+                    printf("The number of bits should be between 1 and 24.\n");
 
-            return;
-        }
+                    return EXIT_FAILURE;
+                }
 
-        for(j = 0; j < base; j++)
-            msgq_read(msgq_1, (long)(j + 1), &msg[j]);
+                base = 0;
 
-        // Find where each worker should start writing in the array
-        to_write = 0;
+                break;
 
-        for(j = 0; j < base; j++) {
-            msg[j].mtype = j + 1;
-            msg[j].write_pos = to_write;
-            to_write += msg[j].num_numbers;
+            case 'B':
+                errno = 0;
+                base = strtol(optarg, &endp, 10);
 
-            msgq_send(msgq_2, &msg[j]);
-        }
+                if(errno != 0 || strlen(endp) > 0) {
+                    printf("The base is not a number or is too large.\n");
 
-        // We wait for everyone to write back in the main array
-        for(j = 0; j < base; j++)
-            sem_lock(sem_worker, 0);
+                    return EXIT_FAILURE;
+                }
 
-        if(i == iter - 1) // Sorting is over
-            shm_write(shm_sorted, 0, 1);
+                if(base <= 1) {
+                    printf("Base should be a positive number greater than 1.\n");
 
-        // Reset the value of the temporary array
-        for(j = 0; j < (long)get_size(base, N); j++)
-            shm_write(shm_temp, j, -1);
+                    return EXIT_FAILURE;
+                }
 
-        for(j = 0; j < base; j++)
-            sem_unlock(sem_master, 1);
-    }
+                bits = 0;
 
-    for(j = 0; j < base; j++)
-        sem_lock(sem_worker, 0); // So no process will try to access an already deleted semaphore
-}
+                break;
 
-/* ----- Main process ----- */
-int main(int argc, char* argv[]) {
-    /* --------------------------------------- */
-    /* ---------- Preparation phase ---------- */
-    /* --------------------------------------- */
+            case 'M':
+                msd = true;
 
-    /* ----- Variable declaration ----- */
-    // User parameters
-    int N, base;
-    long* numbers;
-    char* endp;
+                break;
 
-    // Shared memory segments ID
-    int id_numbers, id_temp, id_sorted;
+            case 'I':
+                american = true;
 
-    // Process management
-    int id;
-    pid_t pid;
+                break;
 
-    // Variable useful for execution
-    int max, iter;
-    long i, value;
+            case 'W':
+                combine = true;
 
-    /* ----- Verification and get the user parameters ----- */
-    // Check the number of parameters
-    if(argc < 4) {
-        printf("Not enough argument.\n");
+                break;
 
-        return EXIT_FAILURE;
-    }
+            case 'i':
+                input = optarg;
 
-    // Retrieving parameter base
-    base = strtol(argv[1], &endp, 10);
+                break;
 
-    if(errno != 0 || strlen(endp) > 0) {
-        printf("The base is not a number or is too large.\n");
+            case 'o':
+                output = optarg;
 
-        return EXIT_FAILURE;
-    }
+                break;
 
-    if(base <= 1) {
-        printf("Base should be a positive number greater than 1.\n");
+            case 'f':
+                if(strcmp(optarg, "binary") == 0) {
+                    binary = true;
+                } else if(strcmp(optarg, "text") == 0) {
+                    binary = false;
+                } else {
+                    printf("The format should be \"text\" or \"binary\".\n");
 
-        return EXIT_FAILURE;
-    }
+                    return EXIT_FAILURE;
+                }
 
-    // Retrieving parameter N
-    N = strtol(argv[2], &endp, 10);
+                break;
 
-    if(errno != 0 || strlen(endp) > 0) {
-        printf("The size is not a number or is too large.\n");
+            case 'm':
+                if((memory = parse_size(optarg)) == 0) {
+                    printf("The memory budget should be a size such as 512M or 32G.\n");
 
-        return EXIT_FAILURE;
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'T':
+                tmpdir = optarg;
+
+                break;
+
+            case 'H':
+                huge = true;
+
+                break;
+
+            case 'A':
+                affinity = true;
+
+                break;
+
+            case 'k':
+                if(parse_key(optarg, &key) == -1) {
+                    printf("The key should be \"int64\", \"uint64\", \"int32\", \"float\" or \"double\".\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'R':
+                rank_str = optarg;
+
+                break;
+
+            case 'K':
+                errno = 0;
+                top = strtol(optarg, &endp, 10);
+
+                if(errno != 0 || strlen(endp) > 0 || top <= 0) {
+                    printf("The number of keys to keep should be a strictly positive number.\n");
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'U':
+                unordered = true;
+
+                break;
+
+            case 'P':
+                profile = optarg;
+
+                break;
+
+            case 'S':
+                return histogram_check(stdout) == 0 && pass_check(stdout) == 0 && radix_check(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+            default:
+                return EXIT_FAILURE;
+        }
     }
 
-    if(N <= 0) {
-        printf("The size should be a strictly positive number.\n");
+    argc -= optind - 1;
+    argv += optind - 1;
 
-        return EXIT_FAILURE;
-    } else {
-        if(N != (argc - 3)) {
-            printf("The size should match the real size of the array.\n");
+    // Options of the sort (0 workers means one per online processor)
+    radix_opts_init(&opts);
+
+    opts.bits = bits;
+    opts.base = base;
+    opts.workers = workers;
+    opts.threads = threads;
+    opts.huge = huge;
+    opts.msd = msd;
+    opts.american = american && rank_str == NULL && top == 0;
+    opts.affinity = affinity;
+    opts.combine = combine;
+    opts.trace = profile != NULL;
+    opts.key = key;
+
+    in_map = NULL;
+    in_length = 0;
+
+    if(input != NULL) {
+        // Retrieving the size from the input file
+        if(argc > 1) {
+            printf("The numbers should be given either in a file or in the command line.\n");
 
             return EXIT_FAILURE;
         }
-    }
 
-    // Allocating array of numbers
-    numbers = (long*)malloc(N * sizeof(long));
+        in_map = file_map(input, &in_length);
 
-    if(numbers == NULL) {
-        printf("Problem with malloc.\n");
+        if(binary) {
+            if(in_length % key_size(key) != 0) {
+                printf("The size of the input file should be a multiple of %zu.\n", key_size(key));
 
-        return EXIT_FAILURE;
-    }
+                return EXIT_FAILURE;
+            }
+
+            N = in_length / key_size(key);
+        } else {
+            N = text_count(in_map, in_length);
+        }
 
-    // Retrieving numbers to sort
-    for(i = 0; i < N; i++) {
-        numbers[i] = strtol(argv[i + 3], &endp, 10);
+        if(N <= 0) {
+            printf("The input file should not be empty.\n");
+
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Check the number of parameters
+        if(argc < 3) {
+            printf("Not enough argument.\n");
+
+            return EXIT_FAILURE;
+        }
+
+        // Retrieving parameter N
+        errno = 0;
+        N = strtol(argv[1], &endp, 10);
 
         if(errno != 0 || strlen(endp) > 0) {
-            printf("An argument is not a number or is too large.\n");
+            printf("The size is not a number or is too large.\n");
+
+            return EXIT_FAILURE;
+        }
+
+        if(N <= 0) {
+            printf("The size should be a strictly positive number.\n");
 
             return EXIT_FAILURE;
         } else {
-            if(numbers[i] < 0) {
-                printf("An argument is not positive.\n");
+            if(N != (argc - 2)) {
+                printf("The size should match the real size of the array.\n");
 
                 return EXIT_FAILURE;
             }
         }
     }
 
-    /* ----- Creation of the shared memory elements ----- */
-    // Array of numbers
-    id_numbers = shm_create(N * sizeof(long), 'N');
-    shm_numbers = shm_attach(id_numbers);
-
-    for(i = 0; i < N; i++)
-        shm_write(shm_numbers, i, numbers[i]);
+    // The rank is known once the number of keys is
+    if(rank_str != NULL && parse_rank(rank_str, N, &rank) == -1) {
+        printf("The rank should be between 0 and %ld, or a percentile such as 99%%.\n", N - 1);
 
-    // Temporary array
-    id_temp = shm_create(get_size(base, N) * sizeof(long), 'T');
-    shm_temp = shm_attach(id_temp);
+        return EXIT_FAILURE;
+    }
 
-    for(i = 0; i < (long)get_size(base, N); i++)
-        shm_write(shm_temp, i, -1);
+    if(top > N) {
+        printf("The number of keys to keep should be at most the number of keys.\n");
 
-    // Variable sorted
-    id_sorted = shm_create(sizeof(long), 'S');
-    shm_sorted = shm_attach(id_sorted);
+        return EXIT_FAILURE;
+    }
 
-    shm_write(shm_sorted, 0, 0); // initialization to the value 0
+    /* ----- External sort if the numbers do not fit in the memory budget ----- */
+    if(memory > 0 && (size_t)N * 2 * sizeof(long) > memory) {
+        if(rank_str != NULL || top > 0) {
+            printf("The selection needs the numbers to fit in the memory budget.\n");
 
-    /* ----- Creation of the semaphores ----- */
-    // Worker
-    sem_worker = sem_create(1, 'W');
+            return EXIT_FAILURE;
+        }
 
-    // Master
-    sem_master = sem_create(2, 'M');
+        if(profile != NULL) {
+            printf("The profile needs the numbers to fit in the memory budget.\n");
 
-    // Initialization to the value 0
-    union semun semopts;
+            return EXIT_FAILURE;
+        }
 
-    semopts.val = 0;
-    semctl(sem_worker, 0, SETVAL, semopts);
-    semctl(sem_master, 0, SETVAL, semopts);
-    semctl(sem_master, 1, SETVAL, semopts);
+        if(input == NULL || output == NULL) {
+            printf("The external sort needs an input and an output file.\n");
 
-    /* ----- Creation of the message queue ----- */
-    msgq_1 = msgq_create('1');
-    msgq_2 = msgq_create('2');
+            return EXIT_FAILURE;
+        }
 
-    /* ----------------------------------- */
-    /* ---------- Sorting phase ---------- */
-    /* ----------------------------------- */
+        if(external_sort(in_map, in_length, output, binary, memory, &opts, tmpdir) == -1) {
+            printf("The input file contains an invalid number.\n");
 
-    /* ----- Finding the maximum value ----- */
-    max = -1;
+            return EXIT_FAILURE;
+        }
 
-    for(i = 0; i < N; i++) {
-        value = shm_read(shm_numbers, i);
+        file_unmap(in_map, in_length);
 
-        if(value > max)
-            max = value;
+        return 0;
     }
 
-    /* ----- Calculating the number of iterations ----- */
-    iter = 0;
+    /* ----- Creation of the scratch buffers and the workers ----- */
+    if((ctx = radix_create(N, &opts)) == NULL) {
+        printf("Problem with malloc.\n");
 
-    while(max > 0) {
-        max /= base;
-        iter++;
+        return EXIT_FAILURE;
     }
 
-    if(iter == 0)
-        iter = 1;
-
-    /* ----- Creation of the different processes ----- */
-    id = 0;
+    /* ----- Retrieving the numbers to sort ----- */
+    valid = true;
 
-    for(i = 0; i < base; i++) {
-        pid = fork();
+    if(input != NULL && binary && key_size(key) == sizeof(long)) {
+        // The mapping is directly the source of the first pass
+        map_input = (long*)in_map;
+    } else if((map_input = radix_buffer(ctx)) == NULL) {
+        printf("Problem with malloc.\n");
 
-        if(pid < 0) {
-            printf("Error while creating process.\n");
+        valid = false;
+    } else if(input != NULL && binary) {
+        // 32-bit keys are widened to 64-bit words
+        binary_widen(in_map, map_input, N, key);
+    } else if(input != NULL) {
+        if(text_parse(in_map, in_length, map_input, key, ctx->workers) == -1) {
+            printf("A line of the input file is not a number or is too large.\n");
 
-            return EXIT_FAILURE;
+            valid = false;
         }
+    } else {
+        for(i = 0; i < N && valid; i++) {
+            // Exactly one number per argument
+            if(text_count(argv[i + 2], strlen(argv[i + 2])) != 1 || text_parse(argv[i + 2], strlen(argv[i + 2]), &map_input[i], key, 1) == -1) {
+                printf("An argument is not a number or is too large.\n");
 
-        if(pid == 0) {
-            worker(id, N, base);
-            i = base;
-        } else {
-            id++;
+                valid = false;
+            }
         }
     }
 
-    if(pid > 0)
-        master(base, iter, N);
+    if(!valid) {
+        radix_destroy(ctx);
+
+        return EXIT_FAILURE;
+    }
+
+    // A binary output file (of 64-bit keys) is directly the destination of the last pass
+    map_output = NULL;
+
+    if(output != NULL && binary && key_size(key) == sizeof(long) && rank_str == NULL && top == 0)
+        map_output = file_create(output, N * sizeof(long));
+
+    /* ----------------------------------- */
+    /* ---------- Sorting phase ---------- */
+    /* ----------------------------------- */
+    if(rank_str != NULL) {
+        // Only the key of the rank
+        selected = radix_run_select(ctx, map_input, N, rank);
+        sorted = &selected;
+    } else if(top > 0) {
+        // Only the smallest keys are written
+        sorted = radix_run_top(ctx, map_input, N, top, !unordered);
+        N = top;
+    } else {
+        sorted = radix_run(ctx, map_input, map_output, N);
+    }
+
+    if(affinity)
+        radix_placement(ctx, stderr);
+
+    if(profile != NULL) {
+        radix_trace(ctx, stderr);
+
+        if(radix_trace_export(ctx, profile) == -1)
+            perror("The trace could not be written");
+    }
 
     /* --------------------------------------- */
     /* ---------- Termination phase ---------- */
     /* --------------------------------------- */
 
-    /* ----- End of the program and display of the result ----- */
-    // Only the master process
-    if(pid > 0) {
-        // Display the sorted array
+    /* ----- Display of the result ----- */
+    if(rank_str != NULL) {
+        number[text_format(number, sorted, 1, key) - 1] = '\0';
+
+        printf("Key of rank %ld: %s\n", rank, number);
+    } else if(output == NULL) {
+        // Display the sorted array (formatted by the workers, written at once)
         printf("Sorted array: ");
+        fflush(stdout);
 
-        for(i = 0; i < N; i++)
-            printf("%ld ", shm_read(shm_numbers, i));
+        if(text_write(STDOUT_FILENO, sorted, N, key, ' ', ctx->workers) == -1)
+            perror("The sorted array could not be written");
 
         printf("\n");
+    } else if(!binary) {
+        // Write the sorted array in the text output file
+        out_fd = file_open(output);
 
-        // Remove IPC elements
-        shm_remove(id_numbers);
-        shm_remove(id_temp);
-        shm_remove(id_sorted);
+        if(text_write(out_fd, sorted, N, key, '\n', ctx->workers) == -1)
+            perror("The output file could not be written");
 
-        sem_remove(sem_worker);
-        sem_remove(sem_master);
+        close(out_fd);
+    } else if(map_output == NULL) {
+        // Narrow the 32-bit keys in the binary output file
+        out_length = N * key_size(key);
+        out_map = file_create(output, out_length);
 
-        msgq_remove(msgq_1);
-        msgq_remove(msgq_2);
+        binary_narrow(out_map, sorted, N, key);
+        file_unmap(out_map, out_length);
+    }
 
-        // Free allocated elements
-        array_free(numbers);
+    // Unmap the files
+    if(map_output != NULL)
+        file_unmap(map_output, N * sizeof(long));
 
-        // Return of the master process
-        return 0;
-    }
+    file_unmap(in_map, in_length);
+
+    // Free the scratch buffers and the workers
+    radix_destroy(ctx);
 
-    // Return of the worker process
     return 0;
 }
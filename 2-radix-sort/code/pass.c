@@ -0,0 +1,315 @@
+/*
+ * File: pass.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the kernels of a pass of the LSD sort,
+ * specialised for each type of keys, width of digits and width of values.
+ * Each kernel is an instance of the same inlined loops, whose parameters
+ * are constants, so that the compiler folds the encoding of the keys and
+ * the mask of the digits, and unrolls the copy of the values.
+ */
+
+#include <string.h>
+
+#include "headers/pass.h"
+
+/* Keys handled at once by the kernels */
+#define PASS_UNROLL 4
+
+/* Digit of an encoded key, for digits of *bits* bits */
+#define PASS_DIGIT(num, shift, bits) (((num) >> (shift)) & ((1UL << (bits)) - 1))
+
+/* Keys and shifts of the self-check */
+#define CHECK_KEYS 10007
+#define CHECK_SHIFTS 3
+
+/* ----- Prototypes ----- */
+static inline unsigned long load(const pass_chunk* c, long i, key_type key, bool first);
+static inline void count_keys(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, bool first);
+static inline void move_key(const pass_chunk* c, long i, long pos, unsigned long num, key_type key, int payload, bool last);
+static inline void scatter_keys(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, int payload, bool first, bool last);
+static void generic_count(const pass_chunk* c, long from, long to, long* row, key_type key, int bits);
+static void generic_scatter(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, int payload);
+
+/* ----------------------------------- */
+/* ---------- Inlined loops ---------- */
+/* ----------------------------------- */
+__attribute__((always_inline))
+static inline unsigned long load(const pass_chunk* c, long i, key_type key, bool first) {
+    unsigned long num;
+
+    num = c->src[i];
+
+    return first ? key_encode(num, key) - c->min : num;
+}
+
+__attribute__((always_inline))
+static inline void count_keys(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, bool first) {
+    long i;
+    int j, shift;
+
+    shift = c->shift;
+
+    for(i = from; i + PASS_UNROLL <= to; i += PASS_UNROLL)
+        for(j = 0; j < PASS_UNROLL; j++)
+            row[PASS_DIGIT(load(c, i + j, key, first), shift, bits)]++;
+
+    for(; i < to; i++)
+        row[PASS_DIGIT(load(c, i, key, first), shift, bits)]++;
+}
+
+__attribute__((always_inline))
+static inline void move_key(const pass_chunk* c, long i, long pos, unsigned long num, key_type key, int payload, bool last) {
+    int j;
+
+    c->dst[pos] = last ? key_decode(num + c->min, key) : num;
+
+    for(j = 0; j < payload; j++)
+        c->vdst[pos * payload + j] = c->vsrc[i * payload + j];
+}
+
+__attribute__((always_inline))
+static inline void scatter_keys(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, int payload, bool first, bool last) {
+    unsigned long num[PASS_UNROLL];
+    long i;
+    int j, shift;
+
+    shift = c->shift;
+
+    // The keys are all read before any is written (the compiler cannot tell that dst is not src)
+    for(i = from; i + PASS_UNROLL <= to; i += PASS_UNROLL) {
+        for(j = 0; j < PASS_UNROLL; j++)
+            num[j] = load(c, i + j, key, first);
+
+        for(j = 0; j < PASS_UNROLL; j++)
+            move_key(c, i + j, row[PASS_DIGIT(num[j], shift, bits)]++, num[j], key, payload, last);
+    }
+
+    for(; i < to; i++) {
+        num[0] = load(c, i, key, first);
+
+        move_key(c, i, row[PASS_DIGIT(num[0], shift, bits)]++, num[0], key, payload, last);
+    }
+}
+
+/* ----------------------------------------- */
+/* ---------- Specialised kernels ---------- */
+/* ----------------------------------------- */
+// One instance of the loops per first/last pass, the other parameters being those of the kernel
+#define PASS_COUNT(K, B) \
+    static void count_##K##_##B(const pass_chunk* c, long from, long to, long* row) { \
+        if(c->first) \
+            count_keys(c, from, to, row, K, B, true); \
+        else \
+            count_keys(c, from, to, row, K, B, false); \
+    }
+
+#define PASS_SCATTER(K, B, P) \
+    static void scatter_##K##_##B##_##P(const pass_chunk* c, long from, long to, long* row) { \
+        if(c->first && c->last) \
+            scatter_keys(c, from, to, row, K, B, P, true, true); \
+        else if(c->first) \
+            scatter_keys(c, from, to, row, K, B, P, true, false); \
+        else if(c->last) \
+            scatter_keys(c, from, to, row, K, B, P, false, true); \
+        else \
+            scatter_keys(c, from, to, row, K, B, P, false, false); \
+    }
+
+// The widths of the values are those of PASS_PAYLOADS
+#define PASS_KERNELS(K, B) \
+    PASS_COUNT(K, B) \
+    PASS_SCATTER(K, B, 0) \
+    PASS_SCATTER(K, B, 1) \
+    PASS_SCATTER(K, B, 2)
+
+#define PASS_ENTRY(K, B) \
+    {K, B, count_##K##_##B, {scatter_##K##_##B##_0, scatter_##K##_##B##_1, scatter_##K##_##B##_2}}
+
+// The widths of the digits: the default one, and those of 6 and 4 passes
+#define PASS_WIDTHS(K) \
+    PASS_KERNELS(K, 8) \
+    PASS_KERNELS(K, 11) \
+    PASS_KERNELS(K, 16)
+
+#define PASS_ENTRIES(K) \
+    PASS_ENTRY(K, 8), \
+    PASS_ENTRY(K, 11), \
+    PASS_ENTRY(K, 16)
+
+PASS_WIDTHS(KEY_INT64)
+PASS_WIDTHS(KEY_UINT64)
+PASS_WIDTHS(KEY_INT32)
+PASS_WIDTHS(KEY_FLOAT)
+PASS_WIDTHS(KEY_DOUBLE)
+
+static const struct {
+    key_type key;
+    int bits;
+    pass_kernel count;
+    pass_kernel scatter[PASS_PAYLOADS];
+} kernels[] = {
+    PASS_ENTRIES(KEY_INT64),
+    PASS_ENTRIES(KEY_UINT64),
+    PASS_ENTRIES(KEY_INT32),
+    PASS_ENTRIES(KEY_FLOAT),
+    PASS_ENTRIES(KEY_DOUBLE)
+};
+
+#define KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+int pass_select(pass_kernels* selected, key_type key, int bits, int record, int payload) {
+    assert(selected != NULL);
+
+    size_t k;
+
+    // The rest of a record is moved with its key by the generic loops
+    if(record != 1 || payload < 0 || payload >= PASS_PAYLOADS)
+        return -1;
+
+    for(k = 0; k < KERNELS; k++) {
+        if(kernels[k].key == key && kernels[k].bits == bits) {
+            selected->count = kernels[k].count;
+            selected->scatter = kernels[k].scatter[payload];
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* -------------------------------- */
+/* ---------- Self-check ---------- */
+/* -------------------------------- */
+static void generic_count(const pass_chunk* c, long from, long to, long* row, key_type key, int bits) {
+    unsigned long num;
+    long i;
+
+    for(i = from; i < to; i++) {
+        num = c->src[i];
+        num = c->first ? key_encode(num, key) - c->min : num;
+
+        row[(num >> c->shift) & ((1UL << bits) - 1)]++;
+    }
+}
+
+static void generic_scatter(const pass_chunk* c, long from, long to, long* row, key_type key, int bits, int payload) {
+    unsigned long num;
+    long i, pos;
+
+    for(i = from; i < to; i++) {
+        num = c->src[i];
+        num = c->first ? key_encode(num, key) - c->min : num;
+        pos = row[(num >> c->shift) & ((1UL << bits) - 1)]++;
+
+        c->dst[pos] = c->last ? key_decode(num + c->min, key) : num;
+
+        if(payload > 0)
+            memcpy(&c->vdst[pos * payload], &c->vsrc[i * payload], payload * sizeof(long));
+    }
+}
+
+int pass_check(FILE* out) {
+    assert(out != NULL);
+
+    pass_chunk chunk;
+    long* keys;
+    long* values;
+    long* generic[3];
+    long* special[3];
+    long i, d, base, total, count;
+    size_t k;
+    int payload, step, mode, result;
+    bool same;
+
+    keys = malloc(CHECK_KEYS * sizeof(long));
+    values = malloc(CHECK_KEYS * (PASS_PAYLOADS - 1) * sizeof(long));
+
+    // Counts (or offsets), keys and values of the generic loops and of the kernel
+    generic[0] = malloc((1L << 16) * sizeof(long));
+    generic[1] = malloc(CHECK_KEYS * sizeof(long));
+    generic[2] = malloc(CHECK_KEYS * (PASS_PAYLOADS - 1) * sizeof(long));
+    special[0] = malloc((1L << 16) * sizeof(long));
+    special[1] = malloc(CHECK_KEYS * sizeof(long));
+    special[2] = malloc(CHECK_KEYS * (PASS_PAYLOADS - 1) * sizeof(long));
+
+    if(keys == NULL || values == NULL || generic[0] == NULL || generic[1] == NULL || generic[2] == NULL || special[0] == NULL || special[1] == NULL || special[2] == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    // Random keys, with runs of repeated keys
+    srand(25);
+
+    for(i = 0; i < CHECK_KEYS; i++)
+        keys[i] = i % 7 == 0 && i > 0 ? keys[i - 1] : ((long)rand() << 33) ^ ((long)rand() << 11) ^ rand();
+
+    for(i = 0; i < CHECK_KEYS * (PASS_PAYLOADS - 1); i++)
+        values[i] = rand();
+
+    same = true;
+
+    for(k = 0; k < KERNELS; k++) {
+        base = 1L << kernels[k].bits;
+
+        for(payload = 0; payload < PASS_PAYLOADS; payload++) {
+            // The first and the last passes (mode), and a few digits of each
+            for(mode = 0; mode < 4; mode++) {
+                for(step = 0; step < CHECK_SHIFTS; step++) {
+                    chunk.src = keys;
+                    chunk.vsrc = values;
+                    chunk.first = mode & 1;
+                    chunk.last = mode & 2;
+                    chunk.shift = (step * (64 / CHECK_SHIFTS) / kernels[k].bits) * kernels[k].bits;
+                    chunk.min = chunk.first ? key_encode(keys[1], kernels[k].key) / 2 : 0;
+
+                    // Counts, then offsets of the digits for the scatter
+                    memset(generic[0], 0, base * sizeof(long));
+                    memset(special[0], 0, base * sizeof(long));
+
+                    generic_count(&chunk, 0, CHECK_KEYS, generic[0], kernels[k].key, kernels[k].bits);
+                    kernels[k].count(&chunk, 0, CHECK_KEYS, special[0]);
+
+                    if(memcmp(generic[0], special[0], base * sizeof(long)) != 0)
+                        same = false;
+
+                    for(total = 0, d = 0; d < base; d++) {
+                        count = generic[0][d];
+                        generic[0][d] = total;
+                        special[0][d] = total;
+                        total += count;
+                    }
+
+                    chunk.dst = generic[1];
+                    chunk.vdst = generic[2];
+
+                    generic_scatter(&chunk, 0, CHECK_KEYS, generic[0], kernels[k].key, kernels[k].bits, payload);
+
+                    chunk.dst = special[1];
+                    chunk.vdst = special[2];
+
+                    kernels[k].scatter[payload](&chunk, 0, CHECK_KEYS, special[0]);
+
+                    if(memcmp(generic[1], special[1], CHECK_KEYS * sizeof(long)) != 0 || memcmp(generic[2], special[2], CHECK_KEYS * payload * sizeof(long)) != 0)
+                        same = false;
+                }
+            }
+        }
+    }
+
+    fprintf(out, "Pass kernels (%zu types and widths of digits, values of 0 to %d words): %s\n", KERNELS, PASS_PAYLOADS - 1, same ? "ok" : "different from the generic loops");
+
+    result = same ? 0 : -1;
+
+    free(keys);
+    free(values);
+
+    for(i = 0; i < 3; i++) {
+        free(generic[i]);
+        free(special[i]);
+    }
+
+    return result;
+}
@@ -0,0 +1,168 @@
+/*
+ * File: pool.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements a persistent pool of threads: the threads are
+ * created once and then run the jobs submitted to the pool, one at a
+ * time, all the threads of the pool working on the same job.
+ */
+
+#include <errno.h>
+
+#include "headers/pool.h"
+
+/* ----- Structure declaration ----- */
+typedef struct {
+    pool* p;
+    int id;
+} thread_info;
+
+/* ----- Prototypes ----- */
+static void* thread(void* arg);
+
+/* ----- Thread of the pool ----- */
+static void* thread(void* arg) {
+    thread_info* info;
+    pool* p;
+    long seen;
+    int id;
+
+    info = arg;
+    p = info->p;
+    id = info->id;
+
+    free(info);
+
+    seen = 0;
+
+    while(true) {
+        // Wait for a new job
+        pthread_mutex_lock(&p->lock);
+
+        while(p->generation == seen && !p->stop)
+            pthread_cond_wait(&p->start, &p->lock);
+
+        if(p->stop) {
+            pthread_mutex_unlock(&p->lock);
+
+            return NULL;
+        }
+
+        seen = p->generation;
+
+        pthread_mutex_unlock(&p->lock);
+
+        p->job(id, p->arg);
+
+        // The last thread to finish signals the caller
+        pthread_mutex_lock(&p->lock);
+
+        if(--p->running == 0)
+            pthread_cond_signal(&p->done);
+
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+pool* pool_create(int size) {
+    assert(size > 0);
+
+    thread_info* info;
+    pool* p;
+    int i, error;
+
+    p = malloc(sizeof(pool));
+
+    if(p == NULL)
+        return NULL;
+
+    p->size = size;
+    p->threads = malloc(size * sizeof(pthread_t));
+
+    if(p->threads == NULL) {
+        free(p);
+
+        return NULL;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    p->generation = 0;
+    p->running = 0;
+    p->stop = false;
+
+    // The calling thread is the thread 0
+    for(i = 1; i < size; i++) {
+        info = malloc(sizeof(thread_info));
+
+        if(info == NULL) {
+            printf("Error with malloc.\n");
+
+            exit(EXIT_FAILURE);
+        }
+
+        info->p = p;
+        info->id = i;
+
+        if((error = pthread_create(&p->threads[i], NULL, thread, info)) != 0) {
+            errno = error;
+            perror("pthread_create");
+
+            exit(errno);
+        }
+    }
+
+    return p;
+}
+
+void pool_run(pool* p, void (*job)(int, void*), void* arg) {
+    assert(p != NULL);
+    assert(job != NULL);
+
+    // Publish the job
+    pthread_mutex_lock(&p->lock);
+
+    p->job = job;
+    p->arg = arg;
+    p->running = p->size - 1;
+    p->generation++;
+
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    // The calling thread works too
+    job(0, arg);
+
+    // Wait for the others
+    pthread_mutex_lock(&p->lock);
+
+    while(p->running > 0)
+        pthread_cond_wait(&p->done, &p->lock);
+
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_free(pool* p) {
+    assert(p != NULL);
+
+    int i;
+
+    pthread_mutex_lock(&p->lock);
+
+    p->stop = true;
+
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    for(i = 1; i < p->size; i++)
+        pthread_join(p->threads[i], NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+
+    free(p->threads);
+    free(p);
+}
@@ -0,0 +1,2228 @@
+/*
+ * File: radix.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library implements the parallel radix sort: several workers that
+ * sort an array of numbers, one digit at a time, through shared
+ * memory and barriers. The workers are either processes forked for each
+ * sort, or the threads of a pool kept from one sort to the next.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#include "headers/affinity.h"
+#include "headers/array.h"
+#include "headers/histogram.h"
+#include "headers/pass.h"
+#include "headers/radix.h"
+
+/* Size of the buckets of the MSD sort sorted by insertion */
+#define MSD_SMALL 64
+
+/* Numbers in a cache line, and the position of a number in its line */
+#define COMBINE_LINE 8
+#define COMBINE_SLOT(p) ((long)(((uintptr_t)(p) / sizeof(long)) % COMBINE_LINE))
+
+/* Chunks of the keys per worker, taken in turn by the workers of a pass, as
+   long as their counts fit in BALANCE_COUNTS numbers (one chunk per worker otherwise) */
+#define BALANCE_CHUNKS 8
+#define BALANCE_COUNTS (1 << 20)
+
+/* Chunks claimed so far (ctx->claims) */
+#define CLAIM_HISTOGRAM 0
+#define CLAIM_SCATTER 1
+#define CLAIM_WIDTH 2
+
+/* Maximal base counted by the histogram kernels (their tables stay in cache) */
+#define HISTOGRAM_BASE (1 << 16)
+
+/* Maximal size (in numbers) of the histograms of all the digits of a worker */
+#define PLAN_HISTOGRAMS (1 << 20)
+
+/* Keys of the self-check of the selection */
+#define CHECK_KEYS 20011
+
+/* Pre-scan of a worker (a line of ctx->scan) */
+#define SCAN_MIN 0
+#define SCAN_MAX 1
+#define SCAN_ASCENDING 2
+#define SCAN_DESCENDING 3
+#define SCAN_WIDTH 4
+
+/* Plan of the current sort (ctx->plan) */
+#define PLAN_MIN 0
+#define PLAN_RESULT 1 // parity of the passes, i.e. the buffer of the sorted keys
+#define PLAN_PASSES 2 // passes over all the keys
+#define PLAN_KEY 3    // encoded key of the selected rank
+#define PLAN_BELOW 4  // keys smaller than it
+#define PLAN_WIDTH 5
+
+/* ----- Prototypes ----- */
+static bool plan(radix_ctx* ctx, int id, int* sense, unsigned long* min, int* iter, unsigned long* skip);
+static void worker(radix_ctx* ctx, int id, tracer* tr);
+static void scatter_combined(radix_ctx* ctx, int id, long* row, const long* src, long* dst, long begin, long end, bool first, bool last, unsigned long min, int pass);
+static inline void combine_flush(long* dst, const long* line, long from, long to, bool streaming);
+static inline void move(radix_ctx* ctx, long* dst, long* vdst, long pos, const long* src, const long* vsrc, long i, unsigned long num);
+static void offsets(radix_ctx* ctx, int id, long lines, int* sense);
+static inline unsigned long digit_of(radix_ctx* ctx, unsigned long num, int level, unsigned long divisor);
+static unsigned long power(radix_ctx* ctx, int level);
+static long* msd_buffer(radix_ctx* ctx, int buffer);
+static void msd_worker(radix_ctx* ctx, int id, tracer* tr);
+static void msd_bucket(radix_ctx* ctx, int id, task* t);
+static void msd_small(radix_ctx* ctx, const task* t);
+static bool msd_steal(radix_ctx* ctx, int id, task* t);
+static void flag_worker(radix_ctx* ctx, int id, tracer* tr);
+static void flag_bucket(radix_ctx* ctx, int id, task* t);
+static void flag_permute(radix_ctx* ctx, int id, long begin, int level, unsigned long divisor);
+static void flag_small(radix_ctx* ctx, const task* t);
+static void select_worker(radix_ctx* ctx, int id, tracer* tr);
+static inline unsigned long high_of(radix_ctx* ctx, unsigned long num, int level);
+static void select_run(radix_ctx* ctx, long* input, size_t N, size_t k, bool gather);
+static void worker_job(int id, void* arg);
+static void place_job(int id, void* arg);
+static void touch_job(int id, void* arg);
+static void launch(radix_ctx* ctx, int count, void (*job)(int, void*));
+static radix_ctx* context(size_t n, int record, int payload, const radix_opts* opts);
+static int sort(long* keys, long* values, size_t n, int record, int payload, const radix_opts* opts);
+static long* buffer_create(radix_ctx* ctx, size_t size, bool huge);
+static void buffer_free(radix_ctx* ctx, long* buffer, size_t size, bool huge);
+
+/* ----- Minimum, maximum and order of the keys (all the workers together) ----- */
+static void scan(radix_ctx* ctx, int id, int* sense, unsigned long* min, unsigned long* max, bool* sorted, bool* reversed) {
+    /* ----- Variable declaration ----- */
+    long i, j, begin, end, N;
+    unsigned long num, next;
+    bool ascending, descending;
+    int workers, record;
+
+    N = ctx->N;
+    workers = ctx->active;
+    record = ctx->record;
+
+    begin = (N * id) / workers;
+    end = (N * (id + 1)) / workers;
+
+    /* ----- Minimum, maximum and order of our slice ----- */
+    *min = ULONG_MAX;
+    *max = 0;
+    ascending = true;
+    descending = true;
+
+    next = key_encode(ctx->input[begin * record], ctx->key);
+
+    for(i = begin; i < end; i++) {
+        num = next;
+
+        if(num < *min)
+            *min = num;
+
+        if(num > *max)
+            *max = num;
+
+        // The pair across the end of our slice is ours too
+        if(i + 1 < N) {
+            next = key_encode(ctx->input[(i + 1) * record], ctx->key);
+
+            ascending = ascending && num <= next;
+            descending = descending && num > next; // strictly, to stay stable
+        }
+    }
+
+    ctx->scan[id * SCAN_WIDTH + SCAN_MIN] = *min;
+    ctx->scan[id * SCAN_WIDTH + SCAN_MAX] = *max;
+    ctx->scan[id * SCAN_WIDTH + SCAN_ASCENDING] = ascending;
+    ctx->scan[id * SCAN_WIDTH + SCAN_DESCENDING] = descending;
+
+    barrier_wait(ctx->pass_barrier, sense);
+
+    /* ----- The same result for everyone ----- */
+    for(j = 0; j < workers; j++) {
+        num = ctx->scan[j * SCAN_WIDTH + SCAN_MIN];
+        *min = num < *min ? num : *min;
+
+        num = ctx->scan[j * SCAN_WIDTH + SCAN_MAX];
+        *max = num > *max ? num : *max;
+
+        ascending = ascending && ctx->scan[j * SCAN_WIDTH + SCAN_ASCENDING];
+        descending = descending && ctx->scan[j * SCAN_WIDTH + SCAN_DESCENDING];
+    }
+
+    if(id == 0)
+        ctx->plan[PLAN_MIN] = *min;
+
+    *sorted = ascending;
+    *reversed = descending;
+}
+
+/* ----- Number of digits of a range of keys ----- */
+static int digits_of(radix_ctx* ctx, unsigned long range) {
+    int n;
+
+    for(n = 0; range > 0; n++)
+        range = ctx->bits > 0 ? range >> ctx->bits : range / ctx->base;
+
+    return n;
+}
+
+/* ----- Pre-scan of the keys (all the workers together) ----- */
+static bool plan(radix_ctx* ctx, int id, int* sense, unsigned long* min, int* iter, unsigned long* skip) {
+    /* ----- Variable declaration ----- */
+    // Destinations of a sorted or reversed input
+    long* target;
+    long* vtarget;
+
+    // Variable useful for execution
+    long i, j, begin, end, base, N;
+    unsigned long num, max, total;
+    unsigned long divisors[64];
+    bool ascending, descending;
+    long* table;
+    int p, workers, record;
+
+    N = ctx->N;
+    base = ctx->base;
+    workers = ctx->active;
+    record = ctx->record;
+
+    begin = (N * id) / workers;
+    end = (N * (id + 1)) / workers;
+
+    scan(ctx, id, sense, min, &max, &ascending, &descending);
+
+    // Already sorted: the keys are copied where the sorted keys go (if needed)
+    if(ascending) {
+        target = ctx->output != NULL ? ctx->output : (ctx->inplace ? ctx->input : ctx->numbers);
+        vtarget = ctx->output != NULL ? ctx->output_values : (ctx->inplace ? ctx->input_values : ctx->values);
+
+        if(target != ctx->input)
+            memcpy(&target[begin * record], &ctx->input[begin * record], (end - begin) * record * sizeof(long));
+
+        if(ctx->payload > 0 && vtarget != ctx->input_values)
+            memcpy(&vtarget[begin * ctx->payload], &ctx->input_values[begin * ctx->payload], (end - begin) * ctx->payload * sizeof(long));
+
+        if(id == 0) {
+            ctx->plan[PLAN_RESULT] = 0;
+            ctx->plan[PLAN_PASSES] = 0;
+        }
+
+        return true;
+    }
+
+    // Sorted in reverse order, without scratch buffer: the two halves are swapped
+    if(descending && ctx->temp == NULL) {
+        for(i = ((N / 2) * id) / workers; i < ((N / 2) * (id + 1)) / workers; i++) {
+            num = ctx->input[i];
+            ctx->input[i] = ctx->input[N - 1 - i];
+            ctx->input[N - 1 - i] = num;
+        }
+
+        if(id == 0) {
+            ctx->plan[PLAN_RESULT] = 0;
+            ctx->plan[PLAN_PASSES] = 1;
+        }
+
+        return true;
+    }
+
+    // Sorted in reverse order: the keys are reversed in the first scratch buffer
+    if(descending) {
+        target = ctx->output != NULL ? ctx->output : ctx->temp;
+        vtarget = ctx->output != NULL ? ctx->output_values : ctx->values_temp;
+
+        for(i = begin; i < end; i++)
+            move(ctx, target, vtarget, N - 1 - i, ctx->input, ctx->input_values, i, ctx->input[i * record]);
+
+        if(id == 0) {
+            ctx->plan[PLAN_RESULT] = 1;
+            ctx->plan[PLAN_PASSES] = 1;
+        }
+
+        return true;
+    }
+
+    /* ----- Passes needed by the range of the keys (minus the minimum) ----- */
+    *iter = digits_of(ctx, max - *min);
+
+    for(divisors[0] = 1, p = 1; p <= *iter && p < 64; p++)
+        divisors[p] = divisors[p - 1] * base;
+
+    /* ----- Histograms of all the digits in one read ----- */
+    if(skip == NULL)
+        return false;
+
+    *skip = 0;
+
+    if(ctx->digits == NULL)
+        return false;
+
+    table = &ctx->digits[id * ctx->passes * base];
+
+    for(i = 0; i < *iter * base; i++)
+        table[i] = 0;
+
+    for(i = begin; i < end; i++) {
+        num = key_encode(ctx->input[i * record], ctx->key) - *min;
+
+        for(p = 0; p < *iter; p++)
+            table[p * base + digit_of(ctx, num, p, divisors[p])]++;
+    }
+
+    barrier_wait(ctx->pass_barrier, sense);
+
+    // The minimum has only zeros: a pass is useless if all the keys have a 0
+    for(p = 0; p < *iter; p++) {
+        total = 0;
+
+        for(j = 0; j < workers; j++)
+            total += ctx->digits[j * ctx->passes * base + p * base];
+
+        if(total == (unsigned long)N)
+            *skip |= 1UL << p;
+    }
+
+    return false;
+}
+
+/* ----- Worker process ----- */
+static void worker(radix_ctx* ctx, int id, tracer* tr) {
+    /* ----- Variable declaration ----- */
+    // Buffers of the current pass (the scratch buffers are used in turn)
+    long* buffers[2];
+    long* values[2];
+    long* src;
+    long* dst;
+    long* vsrc;
+    long* vdst;
+
+    // Plan of the sort
+    unsigned long min, skip;
+    int iter, done, k;
+    bool first, last;
+
+    // Chunks taken by the worker (their counts are the lines of ctx->count)
+    long* row;
+    long chunk, from, to, moved, slices;
+
+    // Variable useful for execution
+    long i, digit, begin, end, N;
+    unsigned long num, base, divisor, mask;
+    int shift, pass, bits, sense, workers, record;
+    key_type key;
+    histogram_digit hist;
+    pass_kernels kernels;
+    pass_chunk pc;
+    bool special;
+
+    /* ----- Get worker informations ----- */
+    N = ctx->N;
+    workers = ctx->active;
+
+    // Where we must read in array (a contiguous slice, whatever the base).
+    begin = (N * id) / workers;
+    end = (N * (id + 1)) / workers;
+
+    base = ctx->base;
+    bits = ctx->bits;
+    key = ctx->key;
+    record = ctx->record;
+
+    mask = base - 1;
+
+    slices = ctx->slices;
+
+    // Kernels specialised for the keys, the digits and the values (see pass.h)
+    special = pass_select(&kernels, key, bits, record, ctx->payload) == 0;
+
+    // Sorting in place uses the input as the second scratch buffer
+    buffers[0] = ctx->temp;
+    buffers[1] = ctx->inplace ? ctx->input : ctx->numbers;
+
+    values[0] = ctx->values_temp;
+    values[1] = ctx->inplace ? ctx->input_values : ctx->values;
+
+    sense = 0;
+
+    /* ----- Plan of the passes ----- */
+    trace_begin(tr);
+
+    if(plan(ctx, id, &sense, &min, &iter, &skip)) {
+        trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * (record + ctx->payload) * sizeof(long));
+
+        return;
+    }
+
+    trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * record * sizeof(long));
+
+    for(done = 0, pass = 0; pass < iter; pass++)
+        done += !(skip >> pass & 1);
+
+    if(id == 0) {
+        ctx->plan[PLAN_RESULT] = done % 2;
+        ctx->plan[PLAN_PASSES] = done;
+    }
+
+    /* ----- Manipulation of the array ----- */
+    for(k = 0, pass = 0; pass < iter; pass++) {
+        // All the keys have the same digit
+        if(skip >> pass & 1)
+            continue;
+
+        // The first pass reads the input, the last one may write the output
+        first = k == 0;
+        last = k == done - 1;
+
+        src = first ? ctx->input : buffers[(k - 1) % 2];
+        dst = last && ctx->output != NULL ? ctx->output : buffers[k % 2];
+
+        vsrc = first ? ctx->input_values : values[(k - 1) % 2];
+        vdst = last && ctx->output != NULL ? ctx->output_values : values[k % 2];
+
+        shift = pass * bits;
+        divisor = power(ctx, pass);
+
+        pc.src = src;
+        pc.dst = dst;
+        pc.vsrc = vsrc;
+        pc.vdst = vdst;
+        pc.min = min;
+        pc.shift = shift;
+        pc.first = first;
+        pc.last = last;
+
+        // Histograms of the chunks we take (the input is not encoded yet)
+        trace_begin(tr);
+
+        for(moved = 0; (chunk = counter_add(&ctx->claims[CLAIM_HISTOGRAM], 1)) < slices; moved += to - from) {
+            from = (N * chunk) / slices;
+            to = (N * (chunk + 1)) / slices;
+            row = &ctx->count[chunk * base];
+
+            for(i = 0; i < (long)base; i++)
+                row[i] = 0;
+
+            if(bits > 0 && ctx->ways != NULL && record == 1 && (!first || key == KEY_INT64 || key == KEY_UINT64)) {
+                // Bare 64-bit keys: vectorised kernel (the encoding is a flip of the sign bit)
+                hist.flip = first && key == KEY_INT64 ? KEY_SIGN64 : 0;
+                hist.min = first ? min : 0;
+                hist.shift = shift;
+                hist.mask = mask;
+
+                histogram_count(ctx->kernel, src + from, to - from, &hist, &ctx->ways[id * HISTOGRAM_WAYS * base], row);
+            } else if(special) {
+                kernels.count(&pc, from, to, row);
+            } else if(bits > 0) {
+                for(i = from; i < to; i++) {
+                    num = src[i * record];
+                    num = first ? key_encode(num, key) - min : num;
+                    digit = (num >> shift) & mask;
+
+                    row[digit]++;
+                }
+            } else {
+                for(i = from; i < to; i++) {
+                    num = src[i * record];
+                    num = first ? key_encode(num, key) - min : num;
+                    digit = (num / divisor) % base;
+
+                    row[digit]++;
+                }
+            }
+        }
+
+        trace_end(tr, TRACE_HISTOGRAM, pass, moved, moved * record * sizeof(long));
+
+        // Wait for all histograms, then compute the offsets together
+        trace_begin(tr);
+        trace_wait(tr, pass, barrier_wait(ctx->pass_barrier, &sense));
+
+        // Nobody takes a chunk to count any more
+        if(id == 0)
+            counter_set(&ctx->claims[CLAIM_HISTOGRAM], 0);
+
+        trace_begin(tr);
+        offsets(ctx, id, slices, &sense);
+        trace_end(tr, TRACE_OFFSETS, pass, 0, 0);
+
+        // The offsets of a chunk are used by whoever takes it
+        trace_begin(tr);
+        trace_wait(tr, pass, barrier_wait(ctx->pass_barrier, &sense));
+
+        // Scatter the chunks we take at their offsets (encoded, except by the last pass)
+        trace_begin(tr);
+
+        for(moved = 0; (chunk = counter_add(&ctx->claims[CLAIM_SCATTER], 1)) < slices; moved += to - from) {
+            from = (N * chunk) / slices;
+            to = (N * (chunk + 1)) / slices;
+            row = &ctx->count[chunk * base];
+
+            if(ctx->combine && record == 1 && ctx->payload == 0) {
+                scatter_combined(ctx, id, row, src, dst, from, to, first, last, min, pass);
+            } else if(special) {
+                kernels.scatter(&pc, from, to, row);
+            } else if(bits > 0) {
+                for(i = from; i < to; i++) {
+                    num = src[i * record];
+                    num = first ? key_encode(num, key) - min : num;
+                    digit = (num >> shift) & mask;
+
+                    move(ctx, dst, vdst, row[digit]++, src, vsrc, i, last ? key_decode(num + min, key) : num);
+                }
+            } else {
+                for(i = from; i < to; i++) {
+                    num = src[i * record];
+                    num = first ? key_encode(num, key) - min : num;
+                    digit = (num / divisor) % base;
+
+                    move(ctx, dst, vdst, row[digit]++, src, vsrc, i, last ? key_decode(num + min, key) : num);
+                }
+            }
+        }
+
+        trace_end(tr, TRACE_SCATTER, pass, moved, moved * (record + ctx->payload) * sizeof(long));
+
+        // Wait for everyone to scatter before reading the next buffer
+        trace_begin(tr);
+        trace_wait(tr, pass, barrier_wait(ctx->pass_barrier, &sense));
+
+        if(id == 0)
+            counter_set(&ctx->claims[CLAIM_SCATTER], 0);
+
+        k++;
+    }
+}
+
+/* ----- Scatter of our slice through write-combining buffers ----- */
+static void scatter_combined(radix_ctx* ctx, int id, long* row, const long* src, long* dst, long begin, long end, bool first, bool last, unsigned long min, int pass) {
+    /* ----- Variable declaration ----- */
+    long* lines;
+    long* starts;
+    long i, d, pos, from, base;
+    unsigned long num, divisor;
+
+    base = ctx->base;
+    divisor = power(ctx, pass);
+
+    lines = &ctx->lines[id * base * COMBINE_LINE];
+    starts = &ctx->starts[id * base];
+
+    // The part of the chunk in each bucket starts at its offset
+    for(d = 0; d < base; d++)
+        starts[d] = row[d];
+
+    /* ----- Staging of the keys, by lines of the destination ----- */
+    for(i = begin; i < end; i++) {
+        num = src[i];
+        num = first ? key_encode(num, ctx->key) - min : num;
+        d = digit_of(ctx, num, pass, divisor);
+        pos = row[d]++;
+
+        lines[d * COMBINE_LINE + COMBINE_SLOT(dst + pos)] = last ? key_decode(num + min, ctx->key) : num;
+
+        // A complete line (or the end of a line that starts before our part) is flushed at once
+        if(COMBINE_SLOT(dst + pos + 1) == 0) {
+            from = pos - COMBINE_SLOT(dst + pos);
+
+            combine_flush(dst, &lines[d * COMBINE_LINE], from > starts[d] ? from : starts[d], pos + 1, true);
+        }
+    }
+
+    /* ----- The incomplete lines are written as usual ----- */
+    for(d = 0; d < base; d++) {
+        pos = row[d];
+
+        from = pos - COMBINE_SLOT(dst + pos);
+
+        if(pos > starts[d] && from != pos)
+            combine_flush(dst, &lines[d * COMBINE_LINE], from > starts[d] ? from : starts[d], pos, false);
+    }
+
+    // The streaming stores are not ordered with the others
+#if defined(__x86_64__)
+    _mm_sfence();
+#endif
+}
+
+static inline void combine_flush(long* dst, const long* line, long from, long to, bool streaming) {
+    long i;
+
+    for(i = from; i < to; i++) {
+#if defined(__x86_64__)
+        // Around the caches, the line is not read before being written
+        if(streaming) {
+            _mm_stream_si64((long long*)&dst[i], line[COMBINE_SLOT(dst + i)]);
+
+            continue;
+        }
+#else
+        (void)streaming;
+#endif
+
+        dst[i] = line[COMBINE_SLOT(dst + i)];
+    }
+}
+
+/* ----- Move of a key, with its record or its values, at its offset ----- */
+static inline void move(radix_ctx* ctx, long* dst, long* vdst, long pos, const long* src, const long* vsrc, long i, unsigned long num) {
+    // The rest of the record follows the key (array of structures)
+    if(ctx->record > 1)
+        memcpy(&dst[pos * ctx->record + 1], &src[i * ctx->record + 1], (ctx->record - 1) * sizeof(long));
+
+    dst[pos * ctx->record] = num;
+
+    // The values are in their own array (structure of arrays)
+    if(ctx->payload > 0)
+        memcpy(&vdst[pos * ctx->payload], &vsrc[i * ctx->payload], ctx->payload * sizeof(long));
+}
+
+/* ----- Write offsets (computed by all the workers together) ----- */
+static void offsets(radix_ctx* ctx, int id, long lines, int* sense) {
+    /* ----- Variable declaration ----- */
+    long j, d, l, count, to_write, base, first, last;
+    int r, workers;
+
+    base = ctx->base;
+    workers = ctx->active;
+
+    /* ----- Scan of our range of digits ----- */
+    // Exclusive prefix sum over (digit, line) inside our digits, in place
+    first = (base * id) / workers;
+    last = (base * (id + 1)) / workers;
+
+    to_write = 0;
+
+    for(d = first; d < last; d++) {
+        for(j = 0; j < lines; j++) {
+            count = ctx->count[j * base + d];
+
+            ctx->count[j * base + d] = to_write;
+            to_write += count;
+        }
+    }
+
+    ctx->total[id] = to_write;
+
+    barrier_wait(ctx->pass_barrier, sense);
+
+    /* ----- Offsets of our lines (one in *workers*) ----- */
+    // Each range of digits starts after the totals of the previous ones
+    for(l = id; l < lines; l += workers) {
+        to_write = 0;
+
+        for(r = 0; r < workers; r++) {
+            first = (base * r) / workers;
+            last = (base * (r + 1)) / workers;
+
+            for(d = first; d < last; d++)
+                ctx->count[l * base + d] += to_write;
+
+            to_write += ctx->total[r];
+        }
+    }
+}
+
+/* ------------------------------- */
+/* ---------- MSD sort ---------- */
+/* ------------------------------- */
+static inline unsigned long digit_of(radix_ctx* ctx, unsigned long num, int level, unsigned long divisor) {
+    if(ctx->bits > 0)
+        return (num >> (level * ctx->bits)) & (ctx->base - 1);
+
+    return (num / divisor) % ctx->base;
+}
+
+/* ----- Digits of a key above a level ----- */
+static inline unsigned long high_of(radix_ctx* ctx, unsigned long num, int level) {
+    if(level + 1 >= ctx->passes)
+        return 0;
+
+    if(ctx->bits > 0)
+        return num >> ((level + 1) * ctx->bits);
+
+    return num / power(ctx, level + 1);
+}
+
+static unsigned long power(radix_ctx* ctx, int level) {
+    unsigned long divisor;
+
+    for(divisor = 1; level > 0 && ctx->bits == 0; level--)
+        divisor *= ctx->base;
+
+    return divisor;
+}
+
+static long* msd_buffer(radix_ctx* ctx, int buffer) {
+    // 0 and 1 are the scratch buffers, 2 is where the sorted keys go
+    if(buffer == 0)
+        return ctx->temp;
+
+    if(buffer == 2 && ctx->output != NULL)
+        return ctx->output;
+
+    return ctx->inplace ? ctx->input : ctx->numbers;
+}
+
+/* ----- Worker process (MSD) ----- */
+static void msd_worker(radix_ctx* ctx, int id, tracer* tr) {
+    /* ----- Variable declaration ----- */
+    long i, d, begin, end, first, last, base, N, sorted;
+    unsigned long num, divisor, min;
+    int sense, workers, level, iter;
+    pass_kernels kernels;
+    pass_chunk pc;
+    bool special;
+    task t;
+
+    N = ctx->N;
+    base = ctx->base;
+    workers = ctx->active;
+
+    begin = (N * id) / workers;
+    end = (N * (id + 1)) / workers;
+
+    sense = 0;
+
+    // The digits are those of the keys minus the minimum
+    trace_begin(tr);
+
+    if(plan(ctx, id, &sense, &min, &iter, NULL)) {
+        trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * sizeof(long));
+
+        return;
+    }
+
+    trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * sizeof(long));
+
+    level = iter - 1;
+    divisor = power(ctx, level);
+
+    // The buckets end where the sorted keys go (after at most one pass per digit)
+    if(id == 0) {
+        ctx->plan[PLAN_RESULT] = 0;
+        ctx->plan[PLAN_PASSES] = iter;
+    }
+
+    /* ----- Partition on the most significant digit (all together) ----- */
+    // A pass of the LSD sort on this digit, with its kernels if it has some (see pass.h)
+    special = ctx->bits > 0 && pass_select(&kernels, ctx->key, ctx->bits, 1, 0) == 0;
+
+    pc.src = ctx->input;
+    pc.dst = ctx->temp;
+    pc.vsrc = NULL;
+    pc.vdst = NULL;
+    pc.min = min;
+    pc.shift = level * ctx->bits;
+    pc.first = true;
+    pc.last = false;
+
+    trace_begin(tr);
+
+    for(d = 0; d < base; d++)
+        ctx->count[id * base + d] = 0;
+
+    if(special) {
+        kernels.count(&pc, begin, end, &ctx->count[id * base]);
+    } else {
+        for(i = begin; i < end; i++) {
+            num = key_encode(ctx->input[i], ctx->key) - min;
+
+            ctx->count[id * base + digit_of(ctx, num, level, divisor)]++;
+        }
+    }
+
+    trace_end(tr, TRACE_HISTOGRAM, level, end - begin, (end - begin) * sizeof(long));
+
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    trace_begin(tr);
+    offsets(ctx, id, workers, &sense);
+    trace_end(tr, TRACE_OFFSETS, level, 0, 0);
+
+    trace_begin(tr);
+
+    if(special) {
+        kernels.scatter(&pc, begin, end, &ctx->count[id * base]);
+    } else {
+        for(i = begin; i < end; i++) {
+            num = key_encode(ctx->input[i], ctx->key) - min;
+
+            ctx->temp[ctx->count[id * base + digit_of(ctx, num, level, divisor)]++] = num;
+        }
+    }
+
+    trace_end(tr, TRACE_SCATTER, level, end - begin, (end - begin) * sizeof(long));
+
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    /* ----- Buckets starting in our range of the output ----- */
+    // The last line of the counts ends at the end of each bucket, so the
+    // workers start with as many keys as each other (not as many digits)
+    first = (N * id) / workers;
+    last = (N * (id + 1)) / workers;
+
+    for(d = 0; d < base; d++) {
+        t.begin = d == 0 ? 0 : ctx->count[(workers - 1) * base + d - 1];
+        t.end = ctx->count[(workers - 1) * base + d];
+        t.level = level - 1;
+        t.buffer = 0;
+
+        if(t.end > t.begin && t.begin >= first && t.begin < last) {
+            counter_add(ctx->pending, 1);
+
+            if(!deque_push(&ctx->deques[id], &t)) {
+                printf("The deque of a worker is full.\n");
+
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // The counts are then used by each worker for its own buckets
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    /* ----- Sorting the buckets (ours first, then stolen ones) ----- */
+    trace_begin(tr);
+
+    for(sorted = 0; true;) {
+        if(deque_pop(&ctx->deques[id], &t) || msd_steal(ctx, id, &t)) {
+            sorted += t.end - t.begin;
+
+            msd_bucket(ctx, id, &t);
+            counter_add(ctx->pending, -1);
+        } else if(counter_get(ctx->pending) == 0) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+
+    // Keys of the buckets, at each of their levels
+    trace_end(tr, TRACE_BUCKETS, -1, sorted, sorted * sizeof(long));
+}
+
+static void msd_bucket(radix_ctx* ctx, int id, task* t) {
+    /* ----- Variable declaration ----- */
+    long* src;
+    long* dst;
+    long* row;
+    long i, d, start, base;
+    unsigned long num, prev, divisor;
+    bool sorted;
+    task child;
+
+    base = ctx->base;
+    row = &ctx->count[id * base];
+
+    while(true) {
+        if(t->level < 0 || t->end - t->begin <= MSD_SMALL) {
+            msd_small(ctx, t);
+
+            return;
+        }
+
+        src = msd_buffer(ctx, t->buffer);
+        divisor = power(ctx, t->level);
+
+        /* ----- Histogram (and check whether the bucket is already sorted) ----- */
+        for(d = 0; d < base; d++)
+            row[d] = 0;
+
+        sorted = true;
+        prev = 0;
+
+        for(i = t->begin; i < t->end; i++) {
+            num = src[i];
+            sorted = sorted && prev <= (unsigned long)num;
+            prev = num;
+
+            row[digit_of(ctx, num, t->level, divisor)]++;
+        }
+
+        if(sorted) {
+            t->level = -1;
+
+            continue;
+        }
+
+        // All the keys have the same digit, there is nothing to move
+        if(row[digit_of(ctx, src[t->begin], t->level, divisor)] == t->end - t->begin) {
+            t->level--;
+
+            continue;
+        }
+
+        break;
+    }
+
+    /* ----- Scatter in the other scratch buffer ----- */
+    start = t->begin;
+
+    for(d = 0; d < base; d++) {
+        i = row[d];
+        row[d] = start;
+        start += i;
+    }
+
+    dst = msd_buffer(ctx, !t->buffer);
+
+    for(i = t->begin; i < t->end; i++)
+        dst[row[digit_of(ctx, src[i], t->level, divisor)]++] = src[i];
+
+    /* ----- Sub-buckets (each line now ends at the end of each bucket) ----- */
+    start = t->begin;
+
+    for(d = 0; d < base; d++) {
+        child.begin = start;
+        child.end = row[d];
+        child.level = t->level - 1;
+        child.buffer = !t->buffer;
+
+        start = row[d];
+
+        // Small buckets are not worth stealing
+        if(child.end - child.begin <= MSD_SMALL) {
+            if(child.end > child.begin)
+                msd_small(ctx, &child);
+
+            continue;
+        }
+
+        counter_add(ctx->pending, 1);
+
+        if(!deque_push(&ctx->deques[id], &child)) {
+            printf("The deque of a worker is full.\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void msd_small(radix_ctx* ctx, const task* t) {
+    long* src;
+    long* dst;
+    long i, j;
+    unsigned long num, min;
+
+    src = msd_buffer(ctx, t->buffer);
+    dst = msd_buffer(ctx, 2);
+    min = ctx->plan[PLAN_MIN];
+
+    // Insertion sort (unless all the digits have been sorted)
+    for(i = t->begin + 1; i < t->end && t->level >= 0; i++) {
+        num = src[i];
+
+        for(j = i; j > t->begin && (unsigned long)src[j - 1] > num; j--)
+            src[j] = src[j - 1];
+
+        src[j] = num;
+    }
+
+    // The keys are decoded where the sorted keys go
+    for(i = t->begin; i < t->end; i++)
+        dst[i] = key_decode(src[i] + min, ctx->key);
+}
+
+static bool msd_steal(radix_ctx* ctx, int id, task* t) {
+    int k;
+
+    for(k = 1; k < ctx->active; k++)
+        if(deque_steal(&ctx->deques[(id + k) % ctx->active], t))
+            return true;
+
+    return false;
+}
+
+/* ----- Worker process (in-place MSD, American flag) ----- */
+static void flag_worker(radix_ctx* ctx, int id, tracer* tr) {
+    /* ----- Variable declaration ----- */
+    long* keys;
+    long* row;
+    long* tails;
+    long i, d, begin, end, base, N, sorted;
+    unsigned long num, divisor, min;
+    int sense, workers, level, iter;
+    task t;
+
+    N = ctx->N;
+    base = ctx->base;
+    workers = ctx->active;
+    keys = ctx->input;
+
+    begin = (N * id) / workers;
+    end = (N * (id + 1)) / workers;
+
+    sense = 0;
+
+    // The digits are those of the keys minus the minimum
+    trace_begin(tr);
+
+    if(plan(ctx, id, &sense, &min, &iter, NULL)) {
+        trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * sizeof(long));
+
+        return;
+    }
+
+    trace_end(tr, TRACE_PLAN, -1, end - begin, (end - begin) * sizeof(long));
+
+    level = iter - 1;
+    divisor = power(ctx, level);
+
+    if(id == 0) {
+        ctx->plan[PLAN_RESULT] = 0;
+        ctx->plan[PLAN_PASSES] = iter;
+    }
+
+    /* ----- Encoding of our slice, and its most significant digits ----- */
+    trace_begin(tr);
+
+    row = &ctx->count[id * base];
+
+    for(d = 0; d < base; d++)
+        row[d] = 0;
+
+    for(i = begin; i < end; i++) {
+        num = key_encode(keys[i], ctx->key) - min;
+        keys[i] = num;
+
+        row[digit_of(ctx, num, level, divisor)]++;
+    }
+
+    trace_end(tr, TRACE_HISTOGRAM, level, end - begin, (end - begin) * sizeof(long));
+
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    /* ----- First level, permuted in place by the first worker ----- */
+    // Its tails are then the ends of the buckets
+    tails = &ctx->flags[base];
+
+    if(id == 0) {
+        trace_begin(tr);
+
+        for(d = 0; d < base; d++)
+            for(tails[d] = 0, i = 0; i < workers; i++)
+                tails[d] += ctx->count[i * base + d];
+
+        flag_permute(ctx, 0, 0, level, divisor);
+
+        trace_end(tr, TRACE_SCATTER, level, N, N * sizeof(long));
+    }
+
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    /* ----- Buckets starting in our slice of the keys ----- */
+    for(d = 0; d < base; d++) {
+        t.begin = d == 0 ? 0 : tails[d - 1];
+        t.end = tails[d];
+        t.level = level - 1;
+        t.buffer = 0;
+
+        if(t.end <= t.begin || t.begin < begin || t.begin >= end)
+            continue;
+
+        if(t.level < 0 || t.end - t.begin <= MSD_SMALL) {
+            flag_small(ctx, &t);
+
+            continue;
+        }
+
+        counter_add(ctx->pending, 1);
+
+        if(!deque_push(&ctx->deques[id], &t)) {
+            printf("The deque of a worker is full.\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The bounds of the first worker are its scratch from now on
+    trace_begin(tr);
+    trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+    /* ----- Sorting the buckets (ours first, then stolen ones) ----- */
+    trace_begin(tr);
+
+    for(sorted = 0; true;) {
+        if(deque_pop(&ctx->deques[id], &t) || msd_steal(ctx, id, &t)) {
+            sorted += t.end - t.begin;
+
+            flag_bucket(ctx, id, &t);
+            counter_add(ctx->pending, -1);
+        } else if(counter_get(ctx->pending) == 0) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+
+    trace_end(tr, TRACE_BUCKETS, -1, sorted, sorted * sizeof(long));
+}
+
+/* ----- Permutation of a bucket in place, by cycles (its counts are the tails of the worker) ----- */
+static void flag_permute(radix_ctx* ctx, int id, long begin, int level, unsigned long divisor) {
+    long* keys;
+    long* heads;
+    long* tails;
+    long d, c, start, base;
+    unsigned long num, swap;
+
+    keys = ctx->input;
+    base = ctx->base;
+
+    heads = &ctx->flags[id * 2 * base];
+    tails = &ctx->flags[id * 2 * base + base];
+
+    // Each sub-bucket is filled from its head up to its tail
+    for(start = begin, d = 0; d < base; d++) {
+        heads[d] = start;
+        start += tails[d];
+        tails[d] = start;
+    }
+
+    // The key at the head of a sub-bucket goes to the head of its own one, and so on
+    for(d = 0; d < base; d++) {
+        while(heads[d] < tails[d]) {
+            num = keys[heads[d]];
+
+            while((c = digit_of(ctx, num, level, divisor)) != d) {
+                swap = keys[heads[c]];
+                keys[heads[c]++] = num;
+                num = swap;
+            }
+
+            keys[heads[d]++] = num;
+        }
+    }
+}
+
+/* ----- Sort of a bucket in place (with its sub-buckets for the workers) ----- */
+static void flag_bucket(radix_ctx* ctx, int id, task* t) {
+    /* ----- Variable declaration ----- */
+    long* keys;
+    long* tails;
+    long i, d, start, base;
+    unsigned long num, prev, divisor;
+    bool sorted;
+    task child;
+
+    keys = ctx->input;
+    base = ctx->base;
+    tails = &ctx->flags[id * 2 * base + base];
+
+    while(true) {
+        if(t->level < 0 || t->end - t->begin <= MSD_SMALL) {
+            flag_small(ctx, t);
+
+            return;
+        }
+
+        divisor = power(ctx, t->level);
+
+        /* ----- Histogram (and check whether the bucket is already sorted) ----- */
+        for(d = 0; d < base; d++)
+            tails[d] = 0;
+
+        sorted = true;
+        prev = 0;
+
+        for(i = t->begin; i < t->end; i++) {
+            num = keys[i];
+            sorted = sorted && prev <= num;
+            prev = num;
+
+            tails[digit_of(ctx, num, t->level, divisor)]++;
+        }
+
+        if(sorted) {
+            t->level = -1;
+
+            continue;
+        }
+
+        // All the keys have the same digit, there is nothing to move
+        if(tails[digit_of(ctx, keys[t->begin], t->level, divisor)] == t->end - t->begin) {
+            t->level--;
+
+            continue;
+        }
+
+        break;
+    }
+
+    /* ----- Permutation in place ----- */
+    flag_permute(ctx, id, t->begin, t->level, divisor);
+
+    /* ----- Sub-buckets (the tails are now their ends) ----- */
+    start = t->begin;
+
+    for(d = 0; d < base; d++) {
+        child.begin = start;
+        child.end = tails[d];
+        child.level = t->level - 1;
+        child.buffer = 0;
+
+        start = tails[d];
+
+        // Small buckets are not worth stealing
+        if(child.end - child.begin <= MSD_SMALL) {
+            if(child.end > child.begin)
+                flag_small(ctx, &child);
+
+            continue;
+        }
+
+        counter_add(ctx->pending, 1);
+
+        if(!deque_push(&ctx->deques[id], &child)) {
+            printf("The deque of a worker is full.\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/* ----- Sort of a small bucket by insertion, and decoding of its keys ----- */
+static void flag_small(radix_ctx* ctx, const task* t) {
+    long* keys;
+    long i, j;
+    unsigned long num, min;
+
+    keys = ctx->input;
+    min = ctx->plan[PLAN_MIN];
+
+    // Insertion sort (unless all the digits have been sorted)
+    for(i = t->begin + 1; i < t->end && t->level >= 0; i++) {
+        num = keys[i];
+
+        for(j = i; j > t->begin && (unsigned long)keys[j - 1] > num; j--)
+            keys[j] = keys[j - 1];
+
+        keys[j] = num;
+    }
+
+    for(i = t->begin; i < t->end; i++)
+        keys[i] = key_decode(keys[i] + min, ctx->key);
+}
+
+/* ----- Worker process (selection of a rank, and of the keys before it) ----- */
+static void select_worker(radix_ctx* ctx, int id, tracer* tr) {
+    /* ----- Variable declaration ----- */
+    // Candidates: the keys of the current prefix, in the input or in a region of temp
+    long* src;
+    long* dst;
+    long n, size, offset, begin, end;
+    bool first, compact;
+
+    // Selection
+    unsigned long prefix, below, rank, num, divisor, min, max;
+    long d, b, total, less, equal, take, cursor;
+    long i, j, base;
+    int level, top, sense, workers;
+    pass_kernels kernels;
+    pass_chunk pc;
+    bool special, ascending, descending;
+
+    base = ctx->base;
+    workers = ctx->active;
+    sense = 0;
+
+    src = ctx->input;
+    size = ctx->N;
+    offset = 0;
+    first = true;
+    compact = false;
+
+    rank = ctx->rank;
+    prefix = 0;
+    below = 0;
+
+    // The histograms of all the candidates are those of a pass of the LSD sort (see pass.h)
+    special = ctx->bits > 0 && pass_select(&kernels, ctx->key, ctx->bits, 1, 0) == 0;
+
+    // The keys minus their minimum, from their most significant non-zero digit (as in the sorts)
+    scan(ctx, id, &sense, &min, &max, &ascending, &descending);
+
+    top = digits_of(ctx, max - min) - 1;
+    pc.min = min;
+
+    /* ----- Bucket of the rank, from the most significant digit ----- */
+    for(level = top; level >= 0; level--) {
+        divisor = power(ctx, level);
+
+        begin = (size * id) / workers;
+        end = (size * (id + 1)) / workers;
+
+        // Histogram of the keys of the prefix (all of them once compacted)
+        trace_begin(tr);
+
+        for(d = 0; d < base; d++)
+            ctx->count[id * base + d] = 0;
+
+        // All the keys are candidates once compacted, or at the most significant digit
+        if(special && (compact || level == top)) {
+            pc.src = src;
+            pc.shift = level * ctx->bits;
+            pc.first = first;
+
+            kernels.count(&pc, begin, end, &ctx->count[id * base]);
+        } else {
+            for(i = begin; i < end; i++) {
+                num = first ? key_encode(src[i], ctx->key) - min : (unsigned long)src[i];
+
+                if(compact || high_of(ctx, num, level) == prefix)
+                    ctx->count[id * base + digit_of(ctx, num, level, divisor)]++;
+            }
+        }
+
+        trace_end(tr, TRACE_HISTOGRAM, level, end - begin, (end - begin) * sizeof(long));
+
+        trace_begin(tr);
+        trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+
+        // Everyone finds the same bucket: the one of the rank
+        for(b = 0, n = 0; b < base; b++) {
+            for(total = 0, j = 0; j < workers; j++)
+                total += ctx->count[j * base + b];
+
+            if(rank < (unsigned long)total) {
+                n = total;
+
+                break;
+            }
+
+            rank -= total;
+            below += total;
+        }
+
+        prefix = prefix * base + b;
+
+        // The candidates are copied once they are at most half of the read ones
+        trace_begin(tr);
+
+        if(n <= size / 2) {
+            dst = first ? ctx->temp : ctx->temp + offset + size;
+
+            for(i = 0, j = 0; j < id; j++)
+                i += ctx->count[j * base + b];
+
+            for(j = begin; j < end; j++) {
+                num = first ? key_encode(src[j], ctx->key) - min : (unsigned long)src[j];
+
+                if((compact || high_of(ctx, num, level) == prefix / base) && digit_of(ctx, num, level, divisor) == (unsigned long)b)
+                    dst[i++] = num;
+            }
+
+            offset = first ? 0 : offset + size;
+            src = dst;
+            size = n;
+            first = false;
+            compact = true;
+        } else {
+            compact = false;
+        }
+
+        trace_end(tr, TRACE_SCATTER, level, compact ? end - begin : 0, compact ? (end - begin) * sizeof(long) : 0);
+
+        // The counts and the candidates are read before the next level
+        trace_begin(tr);
+        trace_wait(tr, level, barrier_wait(ctx->pass_barrier, &sense));
+    }
+
+    // The prefix is now the whole key of the rank (minus the minimum)
+    prefix += min;
+
+    if(id == 0) {
+        ctx->plan[PLAN_KEY] = prefix;
+        ctx->plan[PLAN_BELOW] = below;
+    }
+
+    if(!ctx->gather)
+        return;
+
+    /* ----- Keys before the rank, in the order of the input ----- */
+    size = ctx->N;
+    begin = (size * id) / workers;
+    end = (size * (id + 1)) / workers;
+
+    trace_begin(tr);
+
+    for(less = 0, equal = 0, i = begin; i < end; i++) {
+        num = key_encode(ctx->input[i], ctx->key);
+
+        less += num < prefix;
+        equal += num == prefix;
+    }
+
+    ctx->count[id * base] = less;
+    ctx->count[id * base + 1] = equal;
+
+    trace_end(tr, TRACE_HISTOGRAM, -1, end - begin, (end - begin) * sizeof(long));
+
+    trace_begin(tr);
+    trace_wait(tr, -1, barrier_wait(ctx->pass_barrier, &sense));
+
+    // The smaller keys and the first keys equal to the one of the rank, in
+    // the order of the input: ours go after those taken by the previous workers
+    trace_begin(tr);
+
+    take = ctx->rank + 1 - below;
+
+    for(cursor = 0, j = 0; j < id; j++) {
+        equal = ctx->count[j * base + 1] < take ? ctx->count[j * base + 1] : take;
+        cursor += ctx->count[j * base] + equal;
+        take -= equal;
+    }
+
+    for(i = begin; i < end; i++) {
+        num = key_encode(ctx->input[i], ctx->key);
+
+        if(num < prefix) {
+            ctx->temp[cursor++] = ctx->input[i];
+        } else if(num == prefix && take > 0) {
+            ctx->temp[cursor++] = ctx->input[i];
+            take--;
+        }
+    }
+
+    trace_end(tr, TRACE_SCATTER, -1, end - begin, (end - begin) * sizeof(long));
+}
+
+/* ----- Job of a worker (thread or process) ----- */
+static void worker_job(int id, void* arg) {
+    radix_ctx* ctx;
+    tracer tr;
+
+    ctx = arg;
+
+    // The pool may have more threads than the current sort needs
+    if(id >= ctx->active)
+        return;
+
+    // A forked worker is a new process, it must be pinned again
+    if(ctx->affinity)
+        affinity_pin(ctx->cpus[id]);
+
+    trace_open(&tr, ctx->traces != NULL ? &ctx->traces[id] : NULL, id);
+
+    if(ctx->selecting)
+        select_worker(ctx, id, &tr);
+    else if(ctx->flag)
+        flag_worker(ctx, id, &tr);
+    else if(ctx->top_down)
+        msd_worker(ctx, id, &tr);
+    else
+        worker(ctx, id, &tr);
+
+    trace_close(&tr);
+}
+
+/* ----- Placement of a worker and of its part of the buffers ----- */
+static void place_job(int id, void* arg) {
+    radix_ctx* ctx;
+    size_t begin, end;
+
+    ctx = arg;
+
+    affinity_pin(ctx->cpus[id]);
+
+    // Our slice of the keys and of the values, and our lines of counts
+    begin = (ctx->capacity * id) / ctx->workers;
+    end = (ctx->capacity * (id + 1)) / ctx->workers;
+
+    affinity_touch(ctx->numbers, begin * ctx->record, end * ctx->record);
+    affinity_touch(ctx->temp, begin * ctx->record, end * ctx->record);
+    affinity_touch(ctx->values, begin * ctx->payload, end * ctx->payload);
+    affinity_touch(ctx->values_temp, begin * ctx->payload, end * ctx->payload);
+    affinity_touch(ctx->count, get_index(ctx->base, id * (ctx->chunks / ctx->workers), 0), get_index(ctx->base, (id + 1) * (ctx->chunks / ctx->workers), 0));
+
+    if(ctx->digits != NULL)
+        affinity_touch(ctx->digits, get_index(ctx->passes * ctx->base, id, 0), get_index(ctx->passes * ctx->base, id + 1, 0));
+
+    shm_write(ctx->placement, get_index(2, id, 0), affinity_cpu(id));
+    shm_write(ctx->placement, get_index(2, id, 1), affinity_node());
+}
+
+/* ----- Placement of a worker's part of the buffer of radix_buffer (allocated later) ----- */
+static void touch_job(int id, void* arg) {
+    radix_ctx* ctx;
+
+    ctx = arg;
+
+    affinity_pin(ctx->cpus[id]);
+    affinity_touch(ctx->numbers, (ctx->capacity * id) / ctx->workers * ctx->record, (ctx->capacity * (id + 1)) / ctx->workers * ctx->record);
+}
+
+/* ----- Run of a job by the workers (threads of the pool or forked processes) ----- */
+static void launch(radix_ctx* ctx, int count, void (*job)(int, void*)) {
+    affinity_mask mask;
+    bool saved;
+    int id;
+    pid_t pid;
+
+    if(ctx->threads) {
+        // The caller is the thread 0 of the pool: it is pinned for the job only
+        saved = ctx->affinity && affinity_save(&mask) == 0;
+
+        pool_run(ctx->threads_pool, job, ctx);
+
+        if(saved)
+            affinity_restore(&mask);
+
+        return;
+    }
+
+    for(id = 0; id < count; id++) {
+        pid = fork();
+
+        if(pid < 0) {
+            perror("fork");
+
+            exit(errno);
+        }
+
+        if(pid == 0) {
+            job(id, ctx);
+
+            _exit(0);
+        }
+    }
+
+    // Collect the terminated workers
+    for(id = 0; id < count; id++)
+        wait(NULL);
+}
+
+/* --------------------------------------- */
+/* ---------- Options / context ---------- */
+/* --------------------------------------- */
+void radix_opts_init(radix_opts* opts) {
+    assert(opts != NULL);
+
+    opts->bits = 8;
+    opts->base = 0;
+    opts->workers = 0;
+    opts->threads = true;
+    opts->huge = false;
+    opts->key = KEY_INT64;
+    opts->record = 1;
+    opts->payload = 0;
+    opts->msd = false;
+    opts->american = false;
+    opts->affinity = false;
+    opts->combine = false;
+    opts->trace = false;
+    opts->scratch = NULL;
+}
+
+static long* buffer_create(radix_ctx* ctx, size_t size, bool huge) {
+    // Threads share the plain memory of the process
+    if(!ctx->threads || huge)
+        return shm_map(size, huge);
+
+    return array_create(size / sizeof(long));
+}
+
+static void buffer_free(radix_ctx* ctx, long* buffer, size_t size, bool huge) {
+    if(buffer == NULL)
+        return;
+
+    if(!ctx->threads || huge)
+        shm_unmap(buffer, size, huge);
+    else
+        array_free(buffer);
+}
+
+radix_ctx* radix_create(size_t capacity, const radix_opts* opts) {
+    assert(capacity > 0);
+
+    radix_opts defaults;
+    radix_ctx* ctx;
+    unsigned long max;
+    int i;
+
+    if(opts == NULL) {
+        radix_opts_init(&defaults);
+
+        opts = &defaults;
+    }
+
+    assert(opts->bits > 0 || opts->base > 1);
+
+    if((ctx = malloc(sizeof(radix_ctx))) == NULL)
+        return NULL;
+
+    ctx->capacity = capacity;
+    ctx->bits = opts->bits;
+    ctx->huge = opts->huge;
+    ctx->threads = opts->threads;
+    ctx->key = opts->key;
+    ctx->record = opts->record > 0 ? opts->record : 1;
+    ctx->payload = opts->payload;
+    ctx->msd = opts->msd;
+    ctx->american = opts->american && ctx->record == 1 && ctx->payload == 0;
+    ctx->affinity = opts->affinity;
+    ctx->combine = opts->combine;
+    ctx->trace = opts->trace;
+
+    // No selection until select_run sets one
+    ctx->selecting = false;
+    ctx->rank = 0;
+    ctx->gather = false;
+
+    // A power of two base is handled with shifts and masks
+    ctx->base = opts->bits > 0 ? 1L << opts->bits : opts->base;
+
+    ctx->workers = opts->workers > 0 ? opts->workers : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(ctx->workers <= 0)
+        ctx->workers = 1;
+
+    // No need for more workers than numbers to sort
+    if((size_t)ctx->workers > capacity)
+        ctx->workers = capacity;
+
+    /* ----- Creation of the shared memory elements ----- */
+    // Array of numbers (the second scratch buffer), only if asked for by an
+    // in-place context (see radix_buffer), which sorts the keys where they are
+    ctx->numbers = ctx->american ? NULL : buffer_create(ctx, capacity * ctx->record * sizeof(long), ctx->huge);
+
+    // Temporary array (the first scratch buffer, none for an in-place sort)
+    ctx->temp = ctx->american ? NULL : buffer_create(ctx, capacity * ctx->record * sizeof(long), ctx->huge);
+
+    // Scratch buffers of the values, if any
+    ctx->values = NULL;
+    ctx->values_temp = NULL;
+
+    if(ctx->payload > 0) {
+        ctx->values = buffer_create(ctx, capacity * ctx->payload * sizeof(long), ctx->huge);
+        ctx->values_temp = buffer_create(ctx, capacity * ctx->payload * sizeof(long), ctx->huge);
+    }
+
+    // Digit counts (one line per chunk, one column per digit)
+    ctx->chunks = ctx->workers * BALANCE_CHUNKS * ctx->base <= BALANCE_COUNTS ? ctx->workers * BALANCE_CHUNKS : ctx->workers;
+    ctx->count = buffer_create(ctx, get_size(ctx->chunks, ctx->base) * sizeof(long), false);
+    ctx->claims = buffer_create(ctx, CLAIM_WIDTH * sizeof(long), false);
+
+    // Totals of the ranges of digits scanned by each worker
+    ctx->total = buffer_create(ctx, ctx->workers * sizeof(long), false);
+
+    // Write-combining lines of each worker (one per digit) and the starts of its parts
+    ctx->lines = NULL;
+    ctx->starts = NULL;
+
+    if(ctx->combine) {
+        ctx->lines = buffer_create(ctx, get_size(ctx->workers, ctx->base * COMBINE_LINE) * sizeof(long), false);
+        ctx->starts = buffer_create(ctx, get_size(ctx->workers, ctx->base) * sizeof(long), false);
+    }
+
+    // Tables of the histogram kernel of each worker (for digits of a few bits)
+    ctx->kernel = histogram_select(&ctx->kernel_name);
+    ctx->ways = NULL;
+
+    if(ctx->bits > 0 && ctx->base <= HISTOGRAM_BASE)
+        ctx->ways = buffer_create(ctx, ctx->workers * HISTOGRAM_WAYS * ctx->base * sizeof(long), false);
+
+    // Pre-scan of each worker and plan of the sort
+    ctx->scan = buffer_create(ctx, ctx->workers * SCAN_WIDTH * sizeof(long), false);
+    ctx->plan = buffer_create(ctx, PLAN_WIDTH * sizeof(long), false);
+
+    // Histograms of all the digits (unless they are too large)
+    for(ctx->passes = 0, max = ULONG_MAX; max > 0; ctx->passes++)
+        max = ctx->bits > 0 ? max >> ctx->bits : max / ctx->base;
+
+    ctx->digits = NULL;
+
+    // (the pre-scan of the in-place MSD sort only needs the minimum and the maximum)
+    if(!ctx->american && ctx->passes * ctx->base <= PLAN_HISTOGRAMS)
+        ctx->digits = buffer_create(ctx, ctx->workers * ctx->passes * ctx->base * sizeof(long), false);
+
+    // Deques of the buckets of the MSD sort (a deque never holds more than
+    // the first buckets and disjoint buckets of more than MSD_SMALL keys)
+    ctx->deques = NULL;
+    ctx->tasks = NULL;
+    ctx->pending = NULL;
+    ctx->deque_size = capacity / MSD_SMALL + ctx->base + 1;
+
+    // In place, a worker goes depth first: at most the siblings of each level of its bucket
+    if(ctx->american)
+        ctx->deque_size = (ctx->passes + 1) * ctx->base + 1;
+
+    if(ctx->msd || ctx->american) {
+        ctx->deques = (deque*)buffer_create(ctx, ctx->workers * sizeof(deque), false);
+        ctx->tasks = (task*)buffer_create(ctx, ctx->workers * ctx->deque_size * sizeof(task), false);
+        ctx->pending = buffer_create(ctx, sizeof(long), false);
+    }
+
+    // Heads and tails of the sub-buckets being permuted by each worker
+    ctx->flags = NULL;
+
+    if(ctx->american)
+        ctx->flags = buffer_create(ctx, get_size(ctx->workers, 2 * ctx->base) * sizeof(long), false);
+
+    /* ----- Creation of the barrier ----- */
+    // Between the workers (its size is set before each sort)
+    ctx->pass_barrier = barrier_create(ctx->workers);
+
+    /* ----- Creation of the threads ----- */
+    ctx->threads_pool = ctx->threads ? pool_create(ctx->workers) : NULL;
+
+    // Log of the phases of each worker
+    ctx->traces = NULL;
+
+    if(ctx->trace && (ctx->traces = (trace_log*)buffer_create(ctx, ctx->workers * sizeof(trace_log), false)) != NULL)
+        trace_reset(ctx->traces, ctx->workers);
+
+    // Processor of each worker, and where it has been placed
+    ctx->cpus = NULL;
+    ctx->placement = buffer_create(ctx, ctx->workers * 2 * sizeof(long), false);
+
+    if(ctx->affinity && (ctx->cpus = malloc(ctx->workers * sizeof(int))) != NULL)
+        for(i = 0; i < ctx->workers; i++)
+            ctx->cpus[i] = affinity_cpu(i);
+
+    if((!ctx->american && (ctx->numbers == NULL || ctx->temp == NULL)) || (ctx->payload > 0 && (ctx->values == NULL || ctx->values_temp == NULL)) || ctx->count == NULL || ctx->claims == NULL || ctx->total == NULL || ctx->scan == NULL || ctx->plan == NULL || (ctx->combine && (ctx->lines == NULL || ctx->starts == NULL)) || ((ctx->msd || ctx->american) && (ctx->deques == NULL || ctx->tasks == NULL || ctx->pending == NULL)) || (ctx->american && ctx->flags == NULL) || (ctx->threads && ctx->threads_pool == NULL) || (ctx->trace && ctx->traces == NULL) || ctx->placement == NULL || (ctx->affinity && ctx->cpus == NULL)) {
+        radix_destroy(ctx);
+
+        return NULL;
+    }
+
+    /* ----- Placement ----- */
+    // Each worker touches its part of the buffers first, from its processor
+    for(i = 0; i < ctx->workers; i++) {
+        shm_write(ctx->placement, get_index(2, i, 0), -1);
+        shm_write(ctx->placement, get_index(2, i, 1), -1);
+    }
+
+    if(ctx->affinity)
+        launch(ctx, ctx->workers, place_job);
+
+    return ctx;
+}
+
+long* radix_buffer(radix_ctx* ctx) {
+    assert(ctx != NULL);
+
+    // An in-place context has no buffer until it is asked for
+    if(ctx->numbers == NULL) {
+        ctx->numbers = buffer_create(ctx, ctx->capacity * ctx->record * sizeof(long), ctx->huge);
+
+        if(ctx->numbers != NULL && ctx->affinity)
+            launch(ctx, ctx->workers, touch_job);
+    }
+
+    return ctx->numbers;
+}
+
+void radix_destroy(radix_ctx* ctx) {
+    assert(ctx != NULL);
+
+    if(ctx->threads_pool != NULL)
+        pool_free(ctx->threads_pool);
+
+    buffer_free(ctx, ctx->numbers, ctx->capacity * ctx->record * sizeof(long), ctx->huge);
+    buffer_free(ctx, ctx->temp, ctx->capacity * ctx->record * sizeof(long), ctx->huge);
+    buffer_free(ctx, ctx->values, ctx->capacity * ctx->payload * sizeof(long), ctx->huge);
+    buffer_free(ctx, ctx->values_temp, ctx->capacity * ctx->payload * sizeof(long), ctx->huge);
+    buffer_free(ctx, ctx->count, get_size(ctx->chunks, ctx->base) * sizeof(long), false);
+    buffer_free(ctx, ctx->claims, CLAIM_WIDTH * sizeof(long), false);
+    buffer_free(ctx, ctx->total, ctx->workers * sizeof(long), false);
+    buffer_free(ctx, ctx->lines, get_size(ctx->workers, ctx->base * COMBINE_LINE) * sizeof(long), false);
+    buffer_free(ctx, ctx->starts, get_size(ctx->workers, ctx->base) * sizeof(long), false);
+    buffer_free(ctx, ctx->ways, ctx->workers * HISTOGRAM_WAYS * ctx->base * sizeof(long), false);
+    buffer_free(ctx, ctx->scan, ctx->workers * SCAN_WIDTH * sizeof(long), false);
+    buffer_free(ctx, ctx->plan, PLAN_WIDTH * sizeof(long), false);
+    buffer_free(ctx, ctx->digits, ctx->workers * ctx->passes * ctx->base * sizeof(long), false);
+    buffer_free(ctx, (long*)ctx->deques, ctx->workers * sizeof(deque), false);
+    buffer_free(ctx, (long*)ctx->tasks, ctx->workers * ctx->deque_size * sizeof(task), false);
+    buffer_free(ctx, ctx->pending, sizeof(long), false);
+    buffer_free(ctx, ctx->flags, get_size(ctx->workers, 2 * ctx->base) * sizeof(long), false);
+    buffer_free(ctx, ctx->placement, ctx->workers * 2 * sizeof(long), false);
+    buffer_free(ctx, (long*)ctx->traces, ctx->workers * sizeof(trace_log), false);
+
+    free(ctx->cpus);
+
+    barrier_remove(ctx->pass_barrier);
+
+    free(ctx);
+}
+
+void radix_placement(radix_ctx* ctx, FILE* out) {
+    assert(ctx != NULL);
+    assert(out != NULL);
+
+    const char* names[] = {"numbers", "temp", "values", "values_temp"};
+    long* buffers[4];
+    size_t sizes[4];
+    long pages[AFFINITY_NODES];
+    long unknown;
+    int i, node;
+
+    buffers[0] = ctx->numbers;
+    buffers[1] = ctx->temp;
+    buffers[2] = ctx->values;
+    buffers[3] = ctx->values_temp;
+
+    sizes[0] = sizes[1] = ctx->capacity * ctx->record * sizeof(long);
+    sizes[2] = sizes[3] = ctx->capacity * ctx->payload * sizeof(long);
+
+    // Where the workers were when they touched their part of the buffers
+    for(i = 0; i < ctx->workers; i++)
+        fprintf(out, "Worker %d: processor %ld, node %ld\n", i, shm_read(ctx->placement, get_index(2, i, 0)), shm_read(ctx->placement, get_index(2, i, 1)));
+
+    // Where the pages of the scratch buffers are
+    for(i = 0; i < 4; i++) {
+        if(buffers[i] == NULL)
+            continue;
+
+        unknown = affinity_pages(buffers[i], sizes[i], pages);
+
+        fprintf(out, "Buffer %s:", names[i]);
+
+        for(node = 0; node < AFFINITY_NODES; node++)
+            if(pages[node] > 0)
+                fprintf(out, " node %d: %ld pages,", node, pages[node]);
+
+        fprintf(out, " unknown: %ld pages\n", unknown);
+    }
+}
+
+/* ----------------------------- */
+/* ---------- Sorting ---------- */
+/* ----------------------------- */
+void radix_trace(radix_ctx* ctx, FILE* out) {
+    assert(ctx != NULL);
+    assert(out != NULL);
+
+    if(ctx->traces == NULL) {
+        fprintf(out, "The phases of the workers have not been recorded.\n");
+
+        return;
+    }
+
+    trace_summary(ctx->traces, ctx->workers, out);
+}
+
+int radix_trace_export(radix_ctx* ctx, const char* path) {
+    assert(ctx != NULL);
+    assert(path != NULL);
+
+    if(ctx->traces == NULL)
+        return -1;
+
+    return trace_export(ctx->traces, ctx->workers, path);
+}
+
+long* radix_run(radix_ctx* ctx, long* input, long* output, size_t N) {
+    assert(ctx != NULL);
+    assert(ctx->payload == 0);
+
+    return radix_run_pairs(ctx, input, NULL, output, NULL, N);
+}
+
+long* radix_run_pairs(radix_ctx* ctx, long* input, long* values, long* output, long* out_values, size_t N) {
+    assert(ctx != NULL);
+    assert(input != NULL);
+    assert(ctx->payload == 0 || values != NULL);
+    assert(ctx->payload == 0 || (output == NULL) == (out_values == NULL));
+    assert(N > 0 && N <= ctx->capacity);
+
+    /* ----- Variable declaration ----- */
+    long* target;
+    int id, iter;
+
+    /* ----- Description of the sort ----- */
+    // The workers plan the passes themselves (see plan)
+    ctx->active = (size_t)ctx->workers > N ? (int)N : ctx->workers;
+    ctx->N = N;
+    ctx->input = input;
+    ctx->input_values = values;
+
+    // In place, the input is one of the buffers used in turn
+    ctx->inplace = output == input;
+    ctx->output = ctx->inplace ? NULL : output;
+    ctx->output_values = ctx->inplace ? NULL : out_values;
+
+    // The workers start with a sense of 0, whatever the number of barriers of the previous sort
+    ctx->pass_barrier->size = ctx->active;
+    ctx->pass_barrier->sense = 0;
+
+    // The same number of chunks per worker, whatever the number of workers of the sort
+    ctx->slices = ctx->active * (ctx->chunks / ctx->workers);
+
+    counter_set(&ctx->claims[CLAIM_HISTOGRAM], 0);
+    counter_set(&ctx->claims[CLAIM_SCATTER], 0);
+
+    // The MSD sort only moves bare keys
+    ctx->top_down = ctx->msd && ctx->record == 1 && ctx->payload == 0;
+    ctx->flag = ctx->american;
+
+    // In place, the keys are sorted where the sorted keys go
+    if(ctx->flag) {
+        target = ctx->output != NULL ? ctx->output : (ctx->inplace ? input : radix_buffer(ctx));
+
+        if(target == NULL)
+            return NULL;
+
+        if(target != input)
+            memcpy(target, input, N * sizeof(long));
+
+        ctx->input = target;
+        ctx->inplace = true;
+        ctx->output = NULL;
+    }
+
+    if(ctx->top_down || ctx->flag) {
+        for(id = 0; id < ctx->active; id++)
+            deque_init(&ctx->deques[id], ctx->tasks + id * ctx->deque_size, ctx->deque_size);
+
+        counter_set(ctx->pending, 0);
+    }
+
+    /* ----- Sorting ----- */
+    launch(ctx, ctx->active, worker_job);
+
+    // The last pass wrote either in the output or in one of the scratch buffers
+    iter = shm_read(ctx->plan, PLAN_RESULT);
+    ctx->executed = shm_read(ctx->plan, PLAN_PASSES);
+
+    if(ctx->output != NULL) {
+        ctx->sorted_values = ctx->output_values;
+
+        return ctx->output;
+    }
+
+    if(ctx->inplace) {
+        // After an odd number of passes, the sorted numbers are not in the input
+        if(iter % 2 == 1) {
+            memcpy(input, ctx->temp, N * ctx->record * sizeof(long));
+
+            if(ctx->payload > 0)
+                memcpy(values, ctx->values_temp, N * ctx->payload * sizeof(long));
+        }
+
+        ctx->sorted_values = values;
+
+        return ctx->input;
+    }
+
+    ctx->sorted_values = iter % 2 == 0 ? ctx->values : ctx->values_temp;
+
+    return iter % 2 == 0 ? ctx->numbers : ctx->temp;
+}
+
+/* ----- Selection of a rank (and of the keys before it, in ctx->temp) ----- */
+static void select_run(radix_ctx* ctx, long* input, size_t N, size_t k, bool gather) {
+    ctx->active = (size_t)ctx->workers > N ? (int)N : ctx->workers;
+    ctx->N = N;
+    ctx->input = input;
+    ctx->rank = k;
+    ctx->gather = gather;
+
+    ctx->pass_barrier->size = ctx->active;
+    ctx->pass_barrier->sense = 0;
+
+    ctx->selecting = true;
+
+    launch(ctx, ctx->active, worker_job);
+
+    ctx->selecting = false;
+}
+
+long radix_run_select(radix_ctx* ctx, long* input, size_t N, size_t k) {
+    assert(ctx != NULL);
+    assert(ctx->temp != NULL);
+    assert(input != NULL);
+    assert(ctx->record == 1 && ctx->payload == 0);
+    assert(k < N && N <= ctx->capacity);
+
+    select_run(ctx, input, N, k, false);
+
+    return key_decode(shm_read(ctx->plan, PLAN_KEY), ctx->key);
+}
+
+long* radix_run_top(radix_ctx* ctx, long* input, size_t N, size_t k, bool sorted) {
+    assert(ctx != NULL);
+    assert(ctx->temp != NULL);
+    assert(input != NULL);
+    assert(ctx->record == 1 && ctx->payload == 0);
+    assert(k > 0 && k <= N && N <= ctx->capacity);
+
+    select_run(ctx, input, N, k - 1, true);
+
+    if(!sorted)
+        return ctx->temp;
+
+    // The input is not needed any more: the keys are sorted in place in the first buffer
+    memcpy(ctx->numbers, ctx->temp, k * sizeof(long));
+
+    return radix_run(ctx, ctx->numbers, ctx->numbers, k);
+}
+
+/* ----- Context of a sort of the library (the one of the options if it fits) ----- */
+static radix_ctx* context(size_t n, int record, int payload, const radix_opts* opts) {
+    radix_opts custom;
+    radix_ctx* ctx;
+
+    if(opts == NULL)
+        radix_opts_init(&custom);
+    else
+        custom = *opts;
+
+    custom.record = record;
+    custom.payload = payload;
+
+    // Reuse the context given in the options if it is large enough
+    ctx = custom.scratch;
+
+    // (a selection needs the scratch buffer that an in-place context does not have)
+    if(ctx == NULL || ctx->capacity < n || ctx->record != record || ctx->payload != payload || (ctx->temp == NULL && !custom.american))
+        ctx = radix_create(n, &custom);
+
+    // The type of the keys is the one of the options, even when reusing
+    if(ctx != NULL)
+        ctx->key = custom.key;
+
+    return ctx;
+}
+
+/* ----- Sort of the library, in place ----- */
+static int sort(long* keys, long* values, size_t n, int record, int payload, const radix_opts* opts) {
+    radix_ctx* ctx;
+    long* sorted;
+
+    if(n == 0)
+        return 0;
+
+    if((ctx = context(n, record, payload, opts)) == NULL)
+        return -1;
+
+    if(ctx->threads) {
+        radix_run_pairs(ctx, keys, values, keys, values, n);
+    } else {
+        // Forked workers can read the keys but only write in shared memory
+        sorted = radix_run_pairs(ctx, keys, values, NULL, NULL, n);
+
+        memcpy(keys, sorted, n * record * sizeof(long));
+
+        if(payload > 0)
+            memcpy(values, ctx->sorted_values, n * payload * sizeof(long));
+    }
+
+    if(opts == NULL || ctx != opts->scratch)
+        radix_destroy(ctx);
+
+    return 0;
+}
+
+int radix_sort(long* keys, size_t n, const radix_opts* opts) {
+    assert(keys != NULL || n == 0);
+
+    return sort(keys, NULL, n, 1, 0, opts);
+}
+
+int radix_sort_pairs(long* keys, void* values, size_t n, int payload, const radix_opts* opts) {
+    assert(keys != NULL || n == 0);
+    assert(values != NULL || n == 0);
+    assert(payload > 0);
+
+    return sort(keys, values, n, 1, payload, opts);
+}
+
+int radix_sort_records(void* records, size_t n, int record, const radix_opts* opts) {
+    assert(records != NULL || n == 0);
+    assert(record > 0);
+
+    return sort(records, NULL, n, record, 0, opts);
+}
+
+int radix_select(const long* keys, size_t n, size_t k, long* key, const radix_opts* opts) {
+    assert(keys != NULL);
+    assert(key != NULL);
+    assert(k < n);
+
+    radix_opts custom;
+    radix_ctx* ctx;
+
+    // The selection is never in place
+    if(opts == NULL)
+        radix_opts_init(&custom);
+    else
+        custom = *opts;
+
+    custom.american = false;
+
+    if((ctx = context(n, 1, 0, &custom)) == NULL)
+        return -1;
+
+    *key = radix_run_select(ctx, (long*)keys, n, k);
+
+    if(ctx != custom.scratch)
+        radix_destroy(ctx);
+
+    return 0;
+}
+
+int radix_top(const long* keys, size_t n, size_t k, long* top, bool sorted, const radix_opts* opts) {
+    assert(keys != NULL || k == 0);
+    assert(top != NULL || k == 0);
+    assert(k <= n);
+
+    radix_opts custom;
+    radix_ctx* ctx;
+
+    if(k == 0)
+        return 0;
+
+    // The selection is never in place
+    if(opts == NULL)
+        radix_opts_init(&custom);
+    else
+        custom = *opts;
+
+    custom.american = false;
+
+    if((ctx = context(n, 1, 0, &custom)) == NULL)
+        return -1;
+
+    memcpy(top, radix_run_top(ctx, (long*)keys, n, k, sorted), k * sizeof(long));
+
+    if(ctx != custom.scratch)
+        radix_destroy(ctx);
+
+    return 0;
+}
+
+int radix_argsort(const long* keys, size_t* indices, size_t n, const radix_opts* opts) {
+    assert(keys != NULL || n == 0);
+    assert(indices != NULL || n == 0);
+
+    radix_ctx* ctx;
+    size_t i;
+
+    if(n == 0)
+        return 0;
+
+    if((ctx = context(n, 1, 1, opts)) == NULL)
+        return -1;
+
+    // The indices are the values of the keys, the keys are left untouched
+    for(i = 0; i < n; i++)
+        ctx->values[i] = i;
+
+    radix_run_pairs(ctx, (long*)keys, ctx->values, NULL, NULL, n);
+
+    memcpy(indices, ctx->sorted_values, n * sizeof(size_t));
+
+    if(opts == NULL || ctx != opts->scratch)
+        radix_destroy(ctx);
+
+    return 0;
+}
+
+/* -------------------------------- */
+/* ---------- Self-check ---------- */
+/* -------------------------------- */
+static int compare(const void* a, const void* b) {
+    long x, y;
+
+    x = *(const long*)a;
+    y = *(const long*)b;
+
+    return (x > y) - (x < y);
+}
+
+int radix_check(FILE* out) {
+    assert(out != NULL);
+
+    // Smallest keys of a descending array, in the order of the input
+    static const long descending[] = {9, 8, 7, 6, 5, 4};
+    static const long expected[] = {6, 5, 4};
+
+    radix_opts opts;
+    long* keys;
+    long* sorted;
+    long* top;
+    long* reference;
+    long key;
+    size_t i, j, t, n, k, ranks[] = {0, 1, CHECK_KEYS / 3, CHECK_KEYS / 2, CHECK_KEYS - 1};
+    long ties;
+    int workers, spread;
+    bool same;
+
+    keys = malloc(CHECK_KEYS * sizeof(long));
+    sorted = malloc(CHECK_KEYS * sizeof(long));
+    top = malloc(CHECK_KEYS * sizeof(long));
+    reference = malloc(CHECK_KEYS * sizeof(long));
+
+    if(keys == NULL || sorted == NULL || top == NULL || reference == NULL) {
+        printf("Error with malloc.\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    radix_opts_init(&opts);
+
+    opts.workers = 1;
+
+    same = radix_top(descending, 6, 3, top, false, &opts) == 0 && memcmp(top, expected, sizeof(expected)) == 0;
+
+    srand(20);
+
+    // Keys with many ties (a few values), then keys close to each other, for forked and pooled workers
+    for(spread = 0; spread < 2; spread++) {
+        n = CHECK_KEYS;
+
+        for(i = 0; i < n; i++)
+            keys[i] = spread == 0 ? rand() % 64 - 32 : LONG_MAX - rand() % 100000;
+
+        memcpy(sorted, keys, n * sizeof(long));
+        qsort(sorted, n, sizeof(long), compare);
+
+        for(workers = 1; workers <= 4; workers += 3) {
+            opts.workers = workers;
+            opts.threads = spread == 0;
+
+            for(j = 0; j < sizeof(ranks) / sizeof(ranks[0]); j++) {
+                k = ranks[j];
+
+                // The smaller keys, and the first keys equal to the one of the rank
+                for(ties = k + 1, i = 0; i < n; i++)
+                    ties -= keys[i] < sorted[k];
+
+                for(i = 0, t = 0; i < n; i++)
+                    if(keys[i] < sorted[k] || (keys[i] == sorted[k] && ties-- > 0))
+                        reference[t++] = keys[i];
+
+                if(radix_select(keys, n, k, &key, &opts) != 0 || key != sorted[k])
+                    same = false;
+
+                if(radix_top(keys, n, k + 1, top, true, &opts) != 0 || memcmp(top, sorted, (k + 1) * sizeof(long)) != 0)
+                    same = false;
+
+                if(radix_top(keys, n, k + 1, top, false, &opts) != 0 || memcmp(top, reference, (k + 1) * sizeof(long)) != 0)
+                    same = false;
+            }
+        }
+    }
+
+    fprintf(out, "Selection: %s\n", same ? "ok" : "different from the sort");
+
+    free(keys);
+    free(sorted);
+    free(top);
+    free(reference);
+
+    return same ? 0 : -1;
+}
@@ -0,0 +1,160 @@
+/*
+ * File: service.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library is the client side of the sort daemon: regions of keys
+ * shared with the daemon, and the sorts submitted through its socket.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "headers/service.h"
+
+/* ----- Prototypes ----- */
+static int send_all(int fd, const void* buffer, size_t size);
+
+/* ----- Whole message on the socket ----- */
+static int send_all(int fd, const void* buffer, size_t size) {
+    ssize_t sent;
+
+    for(; size > 0; buffer = (const char*)buffer + sent, size -= sent)
+        if((sent = send(fd, buffer, size, MSG_NOSIGNAL)) <= 0)
+            return -1;
+
+    return 0;
+}
+
+/* --------------------------------- */
+/* ---------- Client side ---------- */
+/* --------------------------------- */
+int service_connect(const char* path) {
+    assert(path != NULL);
+
+    struct sockaddr_un address;
+    int fd;
+
+    if(strlen(path) >= sizeof(address.sun_path))
+        return -1;
+
+    memset(&address, 0, sizeof(address));
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+        return -1;
+
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+int service_region_create(int fd, service_region* region, size_t capacity) {
+    assert(region != NULL);
+    assert(capacity > 0);
+
+    static long created = 0;
+
+    service_request request;
+    service_reply reply;
+    bool busy;
+    int shm;
+
+    // A name of our own (the process and its regions so far)
+    snprintf(region->name, SERVICE_NAME, "/radix-%d-%ld", getpid(), created++);
+
+    region->size = capacity * sizeof(long);
+
+    if((shm = shm_open(region->name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1)
+        return -1;
+
+    if(ftruncate(shm, region->size) == -1) {
+        close(shm);
+        shm_unlink(region->name);
+
+        return -1;
+    }
+
+    region->keys = mmap(NULL, region->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+
+    close(shm);
+
+    if(region->keys == MAP_FAILED) {
+        shm_unlink(region->name);
+
+        return -1;
+    }
+
+    /* ----- Mapping in the daemon ----- */
+    memset(&request, 0, sizeof(request));
+
+    request.type = SERVICE_MAP;
+    request.id = SERVICE_MAP_ID;
+    request.size = region->size;
+
+    strcpy(request.name, region->name);
+
+    // The client has no sort in flight, the reply of the mapping is the next one
+    busy = false;
+
+    if(send_all(fd, &request, sizeof(request)) == -1 || recv(fd, &reply, sizeof(reply), MSG_WAITALL) != sizeof(reply) || (busy = reply.id != SERVICE_MAP_ID) || reply.status < 0) {
+        munmap(region->keys, region->size);
+        shm_unlink(region->name);
+
+        // The reply of a sort has been read instead (see service.h)
+        if(busy)
+            errno = EBUSY;
+
+        return -1;
+    }
+
+    region->index = reply.status;
+
+    return 0;
+}
+
+void service_region_free(service_region* region) {
+    assert(region != NULL);
+
+    munmap(region->keys, region->size);
+    shm_unlink(region->name);
+}
+
+int service_submit(int fd, const service_region* region, size_t offset, size_t n, key_type key, long id) {
+    assert(region != NULL);
+    assert(offset <= region->size / sizeof(long) && n <= region->size / sizeof(long) - offset);
+    assert(id != SERVICE_MAP_ID);
+
+    service_request request;
+
+    memset(&request, 0, sizeof(request));
+
+    request.type = SERVICE_SORT;
+    request.key = key;
+    request.id = id;
+    request.region = region->index;
+    request.offset = offset;
+    request.n = n;
+
+    return send_all(fd, &request, sizeof(request));
+}
+
+int service_wait(int fd, service_reply* reply) {
+    assert(reply != NULL);
+
+    do {
+        if(recv(fd, reply, sizeof(service_reply), MSG_WAITALL) != sizeof(service_reply))
+            return -1;
+    } while(reply->id == SERVICE_MAP_ID);
+
+    return 0;
+}
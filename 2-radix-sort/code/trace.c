@@ -0,0 +1,286 @@
+/*
+ * File: trace.c
+ * Authors: Maxime Meurisse & Valentin Vermeylen
+ *
+ * This library records the phases of the workers of a sort, and reports
+ * them as a summary table or as a Chrome trace.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "headers/communication.h"
+#include "headers/trace.h"
+
+/* ----- Names of the phases ----- */
+static const char* phase_names[] = {"plan", "histogram", "offsets", "scatter", "wait", "buckets"};
+
+/* ----- Prototypes ----- */
+static long now(void);
+static int counter_open(unsigned int type, unsigned long config);
+static void counters_read(const tracer* t, long* values);
+
+/* ----- Monotonic time, in nanoseconds ----- */
+static long now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* ----- Hardware counter of the calling thread (user space only), or -1 ----- */
+static int counter_open(unsigned int type, unsigned long config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counters_read(const tracer* t, long* values) {
+    int c;
+
+    for(c = 0; c < TRACE_COUNTERS; c++)
+        if(t->fds[c] == -1 || read(t->fds[c], &values[c], sizeof(long)) != sizeof(long))
+            values[c] = -1;
+}
+
+/* ------------------------------- */
+/* ---------- Recording ---------- */
+/* ------------------------------- */
+void trace_open(tracer* t, trace_log* log, int worker) {
+    assert(t != NULL);
+
+    int c;
+
+    t->log = log;
+    t->worker = worker;
+
+    for(c = 0; c < TRACE_COUNTERS; c++)
+        t->fds[c] = -1;
+
+    if(log == NULL)
+        return;
+
+    t->fds[TRACE_CACHE_MISSES] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    t->fds[TRACE_TLB_MISSES] = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+void trace_begin(tracer* t) {
+    assert(t != NULL);
+
+    if(t->log == NULL)
+        return;
+
+    counters_read(t, t->counters);
+
+    t->start = now();
+}
+
+void trace_end(tracer* t, trace_phase phase, int pass, long keys, long bytes) {
+    assert(t != NULL);
+
+    trace_event* e;
+    long counters[TRACE_COUNTERS];
+    long end;
+    int c;
+
+    if(t->log == NULL)
+        return;
+
+    end = now();
+
+    counters_read(t, counters);
+
+    if(t->log->count == TRACE_EVENTS) {
+        t->log->dropped++;
+
+        return;
+    }
+
+    e = &t->log->events[t->log->count++];
+
+    e->worker = t->worker;
+    e->pass = pass;
+    e->phase = phase;
+    e->slept = 0;
+    e->start = t->start;
+    e->end = end;
+    e->keys = keys;
+    e->bytes = bytes;
+
+    for(c = 0; c < TRACE_COUNTERS; c++)
+        e->counters[c] = counters[c] == -1 || t->counters[c] == -1 ? -1 : counters[c] - t->counters[c];
+}
+
+void trace_wait(tracer* t, int pass, int how) {
+    assert(t != NULL);
+
+    if(t->log == NULL)
+        return;
+
+    trace_end(t, TRACE_WAIT, pass, 0, 0);
+
+    if(t->log->count > 0)
+        t->log->events[t->log->count - 1].slept = how == BARRIER_SLEPT;
+}
+
+void trace_close(tracer* t) {
+    assert(t != NULL);
+
+    int c;
+
+    for(c = 0; c < TRACE_COUNTERS; c++)
+        if(t->fds[c] != -1)
+            close(t->fds[c]);
+}
+
+void trace_reset(trace_log* logs, int workers) {
+    assert(logs != NULL);
+
+    int w;
+
+    for(w = 0; w < workers; w++) {
+        logs[w].count = 0;
+        logs[w].dropped = 0;
+    }
+}
+
+/* ----------------------------- */
+/* ---------- Reports ---------- */
+/* ----------------------------- */
+void trace_summary(const trace_log* logs, int workers, FILE* out) {
+    assert(logs != NULL);
+    assert(out != NULL);
+
+    /* ----- Variable declaration ----- */
+    const trace_event* e;
+    long time, slowest, keys, bytes, counters[TRACE_COUNTERS], busy, wait, dropped;
+    int w, i, c, pass, phase, last, events, sleeps;
+    bool found;
+
+    // Passes recorded
+    last = -1;
+
+    for(w = 0; w < workers; w++)
+        for(i = 0; i < logs[w].count; i++)
+            last = logs[w].events[i].pass > last ? logs[w].events[i].pass : last;
+
+    /* ----- Phases of each pass, over all the workers ----- */
+    fprintf(out, "%4s  %-9s  %6s  %10s  %10s  %12s  %14s  %12s  %12s  %6s\n", "pass", "phase", "events", "total ms", "max ms", "keys", "bytes", "cache miss", "tlb miss", "sleeps");
+
+    for(pass = -1; pass <= last; pass++) {
+        for(phase = 0; phase < TRACE_PHASES; phase++) {
+            found = false;
+            events = sleeps = 0;
+            time = slowest = keys = bytes = 0;
+
+            for(c = 0; c < TRACE_COUNTERS; c++)
+                counters[c] = 0;
+
+            for(w = 0; w < workers; w++) {
+                for(i = 0; i < logs[w].count; i++) {
+                    e = &logs[w].events[i];
+
+                    if(e->pass != pass || e->phase != phase)
+                        continue;
+
+                    found = true;
+                    events++;
+                    sleeps += e->slept;
+                    time += e->end - e->start;
+                    slowest = e->end - e->start > slowest ? e->end - e->start : slowest;
+                    keys += e->keys;
+                    bytes += e->bytes;
+
+                    for(c = 0; c < TRACE_COUNTERS; c++)
+                        counters[c] = counters[c] == -1 || e->counters[c] == -1 ? -1 : counters[c] + e->counters[c];
+                }
+            }
+
+            if(!found)
+                continue;
+
+            fprintf(out, "%4d  %-9s  %6d  %10.3f  %10.3f  %12ld  %14ld  %12ld  %12ld  %6d\n", pass, phase_names[phase], events, time / 1e6, slowest / 1e6, keys, bytes, counters[TRACE_CACHE_MISSES], counters[TRACE_TLB_MISSES], sleeps);
+        }
+    }
+
+    /* ----- Time of each worker ----- */
+    fprintf(out, "\n%6s  %10s  %10s  %8s\n", "worker", "busy ms", "wait ms", "dropped");
+
+    for(dropped = 0, w = 0; w < workers; w++) {
+        busy = wait = 0;
+
+        for(i = 0; i < logs[w].count; i++) {
+            e = &logs[w].events[i];
+
+            if(e->phase == TRACE_WAIT)
+                wait += e->end - e->start;
+            else
+                busy += e->end - e->start;
+        }
+
+        dropped += logs[w].dropped;
+
+        fprintf(out, "%6d  %10.3f  %10.3f  %8ld\n", w, busy / 1e6, wait / 1e6, logs[w].dropped);
+    }
+
+    if(dropped > 0)
+        fprintf(out, "\n%ld events have been dropped (at most %d per worker).\n", dropped, TRACE_EVENTS);
+}
+
+int trace_export(const trace_log* logs, int workers, const char* path) {
+    assert(logs != NULL);
+    assert(path != NULL);
+
+    /* ----- Variable declaration ----- */
+    const trace_event* e;
+    FILE* file;
+    long origin;
+    int w, i;
+    bool first;
+
+    if((file = fopen(path, "w")) == NULL)
+        return -1;
+
+    // The times are relative to the first event
+    origin = -1;
+
+    for(w = 0; w < workers; w++)
+        for(i = 0; i < logs[w].count; i++)
+            if(origin == -1 || logs[w].events[i].start < origin)
+                origin = logs[w].events[i].start;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+    first = true;
+
+    for(w = 0; w < workers; w++) {
+        fprintf(file, "%s  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"worker %d\"}}", first ? "" : ",\n", w, w);
+
+        first = false;
+
+        for(i = 0; i < logs[w].count; i++) {
+            e = &logs[w].events[i];
+
+            fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"pass\": %d, \"keys\": %ld, \"bytes\": %ld, \"cache_misses\": %ld, \"tlb_misses\": %ld, \"slept\": %d}}", phase_names[e->phase], e->phase == TRACE_WAIT ? "barrier" : "sort", w, (e->start - origin) / 1e3, (e->end - e->start) / 1e3, e->pass, e->keys, e->bytes, e->counters[TRACE_CACHE_MISSES], e->counters[TRACE_TLB_MISSES], e->slept);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    if(fclose(file) == EOF)
+        return -1;
+
+    return 0;
+}